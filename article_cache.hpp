@@ -0,0 +1,203 @@
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+/**
+ * @brief 把尚未写回数据库的浏览量加到文章详情json的views_count上
+ * views_count位于content之后，从尾部查找，content中的引号都已转义不会误匹配
+ */
+inline std::string add_pending_views(std::string_view json, uint64_t delta) {
+  constexpr std::string_view key = "\"views_count\":";
+  auto pos = json.rfind(key);
+  if (pos == std::string_view::npos || delta == 0) {
+    return std::string(json);
+  }
+
+  size_t begin = pos + key.size();
+  size_t end = begin;
+  uint64_t views = 0;
+  while (end < json.size() &&
+         std::isdigit(static_cast<unsigned char>(json[end]))) {
+    views = views * 10 + (json[end] - '0');
+    ++end;
+  }
+
+  std::string result;
+  result.reserve(json.size() + 20);
+  result.append(json.substr(0, begin))
+      .append(std::to_string(views + delta))
+      .append(json.substr(end));
+  return result;
+}
+
+/**
+ * @brief 文章详情缓存
+ * 以slug为键缓存序列化好的文章详情json，按分片加锁，每个分片独立做LRU淘汰，
+ * 所有分片的总内存不超过配置的上限。文章被编辑、审核、加精、删除时需要调用
+ * invalidate使缓存失效；浏览量写回数据库后由view_counter调用add_views
+ * 同步缓存中的浏览量，不需要重新查询。
+ */
+class article_cache {
+public:
+  using value_type = std::shared_ptr<const std::string>;
+
+  article_cache(const article_cache &) = delete;
+  article_cache &operator=(const article_cache &) = delete;
+
+  static article_cache &instance() {
+    static article_cache instance;
+    return instance;
+  }
+
+  /**
+   * @brief 设置缓存的内存上限
+   * @param max_bytes 所有分片的总字节数，为0时关闭缓存
+   */
+  void init(size_t max_bytes) {
+    for (auto &shard : shards_) {
+      std::lock_guard lock(shard.mutex);
+      shard.max_bytes = max_bytes / shard_num;
+      shard.evict();
+    }
+    CINATRA_LOG_INFO << "article cache max bytes: " << max_bytes;
+  }
+
+  /**
+   * @brief 查询缓存，命中时把该项移到LRU头部
+   * @return 未命中返回nullptr
+   */
+  value_type get(std::string_view slug) {
+    auto &shard = get_shard(slug);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.map.find(slug);
+    if (it == shard.map.end()) {
+      return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->value;
+  }
+
+  /**
+   * @brief 写入缓存，超过单个分片上限的条目不缓存
+   */
+  void put(std::string_view slug, std::string json) {
+    auto &shard = get_shard(slug);
+    size_t bytes = slug.size() + json.size();
+    std::lock_guard lock(shard.mutex);
+    if (bytes > shard.max_bytes) {
+      return;
+    }
+
+    shard.erase(slug);
+    shard.lru.push_front(
+        {std::string(slug),
+         std::make_shared<const std::string>(std::move(json)), bytes});
+    shard.map.emplace(shard.lru.front().key, shard.lru.begin());
+    shard.used_bytes += bytes;
+    shard.evict();
+  }
+
+  /**
+   * @brief 缓存的文章详情的views_count加上n，未缓存时不做任何操作
+   */
+  void add_views(std::string_view slug, uint64_t n) {
+    auto &shard = get_shard(slug);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.map.find(slug);
+    if (it == shard.map.end() || n == 0) {
+      return;
+    }
+
+    // 缓存的json可能正被其它请求使用，生成新的json替换
+    auto &item = *it->second;
+    auto json = std::make_shared<const std::string>(
+        add_pending_views(*item.value, n));
+    size_t bytes = item.key.size() + json->size();
+    shard.used_bytes = shard.used_bytes - item.bytes + bytes;
+    item.value = std::move(json);
+    item.bytes = bytes;
+    shard.evict();
+  }
+
+  /**
+   * @brief 使某篇文章的缓存失效
+   */
+  void invalidate(std::string_view slug) {
+    auto &shard = get_shard(slug);
+    std::lock_guard lock(shard.mutex);
+    shard.erase(slug);
+  }
+
+  /**
+   * @brief 清空所有缓存
+   */
+  void clear() {
+    for (auto &shard : shards_) {
+      std::lock_guard lock(shard.mutex);
+      shard.map.clear();
+      shard.lru.clear();
+      shard.used_bytes = 0;
+    }
+  }
+
+private:
+  article_cache() = default;
+
+  static constexpr size_t shard_num = 16;
+
+  struct entry {
+    std::string key;
+    value_type value;
+    size_t bytes;
+  };
+
+  struct shard_t {
+    std::mutex mutex;
+    std::list<entry> lru;
+    // key指向lru中entry的key，entry在list中的地址是稳定的
+    std::unordered_map<std::string_view, std::list<entry>::iterator> map;
+    size_t used_bytes = 0;
+    size_t max_bytes = 0;
+
+    void erase(std::string_view slug) {
+      auto it = map.find(slug);
+      if (it == map.end()) {
+        return;
+      }
+      used_bytes -= it->second->bytes;
+      auto list_it = it->second;
+      map.erase(it);
+      lru.erase(list_it);
+    }
+
+    void evict() {
+      while (used_bytes > max_bytes && !lru.empty()) {
+        auto &back = lru.back();
+        used_bytes -= back.bytes;
+        map.erase(back.key);
+        lru.pop_back();
+      }
+    }
+  };
+
+  shard_t &get_shard(std::string_view slug) {
+    return shards_[std::hash<std::string_view>{}(slug) % shard_num];
+  }
+
+  std::array<shard_t, shard_num> shards_;
+};
+
+} // namespace purecpp
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "db_executor.hpp"
+#include "entity.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// “社区精华”标签的ID
+inline constexpr int featured_tag_id = 108;
+
+/**
+ * @brief 解析用竖线分隔的标签ID字符串，如"1|108"
+ * 非数字的部分直接跳过，结果去重
+ */
+inline std::vector<int> parse_tag_ids(std::string_view tag_ids) {
+  std::vector<int> result;
+  while (!tag_ids.empty()) {
+    auto pos = tag_ids.find('|');
+    auto item = tag_ids.substr(0, pos);
+    int tag_id = 0;
+    auto [ptr, ec] =
+        std::from_chars(item.data(), item.data() + item.size(), tag_id);
+    if (ec == std::errc{} && ptr == item.data() + item.size() && tag_id > 0) {
+      result.push_back(tag_id);
+    }
+    if (pos == std::string_view::npos) {
+      break;
+    }
+    tag_ids.remove_prefix(pos + 1);
+  }
+
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+/**
+ * @brief 把标签ID拼接成字符串
+ * 默认生成sql中IN (...)的列表，如"1,2,3"；separator为'|'时生成
+ * articles表tag_ids字段的格式，如"1|108"
+ */
+inline std::string join_tag_ids(const std::vector<int> &tag_ids,
+                                char separator = ',') {
+  std::string result;
+  for (int tag_id : tag_ids) {
+    if (!result.empty()) {
+      result.push_back(separator);
+    }
+    result.append(std::to_string(tag_id));
+  }
+  return result;
+}
+
+/**
+ * @brief 用tag_ids重写某篇文章在article_tags表中的记录
+ * @param conn 数据库连接
+ * @param article_id 文章ID
+ * @param tag_ids 用竖线分隔的标签ID
+ * @return 操作是否成功
+ */
+inline bool save_article_tags(db_conn &conn, uint64_t article_id,
+                              std::string_view tag_ids) {
+  if (!conn->execute("DELETE FROM `article_tags` WHERE article_id = " +
+                     std::to_string(article_id))) {
+    return false;
+  }
+
+  std::vector<article_tags_t> rows;
+  for (int tag_id : parse_tag_ids(tag_ids)) {
+    rows.push_back({article_id, tag_id});
+  }
+  if (rows.empty()) {
+    return true;
+  }
+  return conn->insert(rows) == static_cast<int>(rows.size());
+}
+
+/**
+ * @brief 从articles表已有的tag_ids回填article_tags表
+ * 只在article_tags表为空时执行，已经迁移过的库不会重复执行
+ */
+inline void backfill_article_tags(db_conn &conn) {
+  size_t count =
+      conn->select(ormpp::count()).from<article_tags_t>().collect();
+  if (count > 0) {
+    return;
+  }
+
+  auto articles = conn->select(col(&articles_t::article_id),
+                               col(&articles_t::tag_ids))
+                      .from<articles_t>()
+                      .collect();
+  if (articles.empty()) {
+    return;
+  }
+
+  std::vector<article_tags_t> rows;
+  for (auto &[article_id, tag_ids] : articles) {
+    for (int tag_id : parse_tag_ids(tag_ids)) {
+      rows.push_back({article_id, tag_id});
+    }
+  }
+  if (rows.empty()) {
+    return;
+  }
+
+  conn->begin();
+  if (conn->insert(rows) != static_cast<int>(rows.size())) {
+    conn->rollback();
+    CINATRA_LOG_ERROR << "backfill article_tags failed: "
+                      << conn->get_last_error();
+    return;
+  }
+  conn->commit();
+  CINATRA_LOG_INFO << "backfill article_tags, articles: " << articles.size()
+                   << ", rows: " << rows.size();
+}
+
+} // namespace purecpp
@@ -1,8 +1,16 @@
 #pragma once
 
+#include "article_cache.hpp"
+#include "article_tags.hpp"
 #include "articles_dto.hpp"
+#include "count_cache.hpp"
 #include "common.hpp"
+#include "db_executor.hpp"
+#include "search_index.hpp"
+#include "tags.hpp"
+#include "upload_store.hpp"
 #include "user_aspects.hpp"
+#include "view_counter.hpp"
 
 #include <random>
 
@@ -22,6 +30,8 @@ struct article_page_request {
   int current_page;
   int per_page;
   std::string search; // 搜索关键词
+  std::string cursor; // 分页游标，不为空时忽略current_page
+  bool skip_count = false; // 翻到第二页以后不再统计总数，total_count返回-1
 };
 
 struct article_list {
@@ -36,6 +46,7 @@ struct article_list {
   uint32_t views_count;
   uint32_t comments_count;
   int featured_weight;
+  uint64_t article_id;
 };
 
 struct pending_article_list {
@@ -49,6 +60,7 @@ struct pending_article_list {
   uint64_t updated_at;
   uint32_t views_count;
   uint32_t comments_count;
+  uint64_t article_id;
 };
 
 static std::string_view REVIEW_REJECTED = "rejected"; // 审核_已拒绝
@@ -100,12 +112,13 @@ inline void generate_random_string(auto &random_str) {
 
 class articles {
 public:
-  void handle_new_article(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void> handle_new_article(coro_http_request &req,
+                                                    coro_http_response &resp) {
     auto body = req.get_body();
     if (body.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，请求体不能为空"));
-      return;
+      co_return;
     }
 
     client_artilce art{};
@@ -115,50 +128,50 @@ public:
       resp.set_status_and_content(
           status_type::bad_request,
           make_error("无效的请求参数，JSON格式错误: " + ec.message()));
-      return;
+      co_return;
     }
 
     // 验证标题
     if (art.title.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("标题不能为空"));
-      return;
+      co_return;
     }
     if (art.title.size() > 100) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("标题太长，不要超过100个字符"));
-      return;
+      co_return;
     }
 
     // 验证摘要
     if (art.excerpt.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("摘要不能为空"));
-      return;
+      co_return;
     }
     if (art.excerpt.size() > 300) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("摘要太长，不要超过300个字符"));
-      return;
+      co_return;
     }
 
     // 验证内容
     if (art.content.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("内容不能为空"));
-      return;
+      co_return;
     }
     if (art.content.size() > 64 * 1024) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("内容太长，不要超过64KB个字符"));
-      return;
+      co_return;
     }
 
     // 验证标签ID
     if (art.tag_ids.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("请至少选择一个标签"));
-      return;
+      co_return;
     }
 
     // 从token中提取用户ID
@@ -166,7 +179,7 @@ public:
     if (user_id == 0) {
       resp.set_status_and_content(status_type::unauthorized,
                                   make_error("用户未登录或登录已过期"));
-      return;
+      co_return;
     }
 
     articles_t article{};
@@ -191,85 +204,101 @@ public:
       pos += 1;
     }
 
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
-
-    int retry = 5;
-    uint64_t article_id = 0;
-    for (; retry > 0; retry--) {
-      article_id = conn->get_insert_id_after_insert(article);
-      if (article_id > 0) {
-        break;
+    auto article_id = co_await db_exec([&](db_conn &conn) -> uint64_t {
+      for (int retry = 5; retry > 0; retry--) {
+        // 文章和标签关系在同一个事务中写入，不会出现没有标签记录的文章
+        conn->begin();
+        uint64_t id = conn->get_insert_id_after_insert(article);
+        if (id > 0) {
+          if (!save_article_tags(conn, id, article.tag_ids) ||
+              !conn->commit()) {
+            CINATRA_LOG_ERROR << "保存文章标签失败: "
+                              << conn->get_last_error();
+            conn->rollback();
+            return 0;
+          }
+          return id;
+        }
+        conn->rollback();
+        generate_random_string(article.slug);
       }
-      generate_random_string(article.slug);
-    }
 
-    if (retry == 0) {
       auto err = conn->get_last_error();
       CINATRA_LOG_ERROR << "提交文章失败: " << err;
+      return 0;
+    });
+    if (!article_id.has_value() || article_id.value() == 0) {
       set_server_internel_error(resp);
-      return;
+      co_return;
     }
+    search_index::instance().update(article_id.value(), article.title,
+                                    article.abstraction, article.content);
+    count_cache::instance().invalidate();
 
     resp.set_status_and_content(status_type::ok,
                                 make_success("文章提交成功，等待审核"));
   }
 
-  void show_article(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void> show_article(coro_http_request &req,
+                                              coro_http_response &resp) {
     auto it = req.params_.find("slug");
     if (it == req.params_.end()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，缺少文章标识符"));
-      return;
+      co_return;
     }
 
     auto slug = it->second;
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
+    if (auto json = article_cache::instance().get(slug); json != nullptr) {
+      // 命中缓存，浏览量只在内存中累加，由view_counter定期写回数据库
+      uint64_t pending = view_counter::instance().increment(slug);
+      resp.set_status_and_content(status_type::ok,
+                                  add_pending_views(*json, pending));
+      co_return;
+    }
+
+    // 查询和写入缓存期间不写回浏览量，缓存中保存数据库里的浏览量，
+    // 返回时再加上未写回的增量；json为空表示文章不存在
+    auto json = co_await db_exec([&](db_conn &conn) {
+      auto flush_lock = view_counter::instance().hold_flush();
+      auto list =
+          conn->select(col(&articles_t::title), col(&articles_t::abstraction),
+                       col(&articles_t::content), col(&users_t::user_name),
+                       col(&articles_t::tag_ids), col(&articles_t::created_at),
+                       col(&articles_t::updated_at),
+                       col(&articles_t::views_count),
+                       col(&articles_t::comments_count),
+                       col(&articles_t::featured_weight))
+              .from<articles_t>()
+              .inner_join(col(&articles_t::author_id), col(&users_t::id))
+              .where(col(&articles_t::slug).param() &&
+                     col(&articles_t::is_deleted) == 0)
+              .collect<article_detail>(slug);
+      if (list.empty()) {
+        return std::string{};
+      }
+      auto detail = make_data(std::move(list.front()), "获取文章详情成功");
+      article_cache::instance().put(slug, detail);
+      return detail;
+    });
+    if (!json.has_value()) {
       set_server_internel_error(resp);
-      return;
-    }
-
-    // 先更新浏览量
-    conn->execute(
-        "UPDATE `articles` SET views_count = views_count + 1 WHERE slug = '" +
-        std::string(slug) + "'");
-
-    // 再获取文章详情
-    auto list =
-        conn->select(col(&articles_t::title), col(&articles_t::abstraction),
-                     col(&articles_t::content), col(&users_t::user_name),
-                     col(&articles_t::tag_ids), col(&articles_t::created_at),
-                     col(&articles_t::updated_at),
-                     col(&articles_t::views_count),
-                     col(&articles_t::comments_count),
-                     col(&articles_t::featured_weight))
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(col(&articles_t::slug).param() &&
-                   col(&articles_t::is_deleted) == 0)
-            .collect<article_detail>(slug);
-
-    if (!list.empty()) {
-      std::string json = make_data(std::move(list[0]), "获取文章详情成功");
-      resp.set_status_and_content(status_type::ok, std::move(json));
+      co_return;
+    }
+
+    if (!json->empty()) {
+      uint64_t pending = view_counter::instance().increment(slug);
+      resp.set_status_and_content(status_type::ok,
+                                  add_pending_views(*json, pending));
     } else {
       resp.set_status_and_content(status_type::not_found,
                                   make_error("文章不存在或已被删除"));
     }
   }
 
-  void edit_article(coro_http_request &req, coro_http_response &resp) {
-    edit_article_info info =
-        std::any_cast<edit_article_info>(req.get_user_data());
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
+  async_simple::coro::Lazy<void> edit_article(coro_http_request &req,
+                                              coro_http_response &resp) {
+    edit_article_info info = get_request_data<edit_article_info>(req);
 
     // 文章编辑以后，上次审核结果也删掉
     articles_t article{};
@@ -286,28 +315,51 @@ public:
     // 使用安全的字符串拼接，避免SQL注入风险
     std::string slug = "slug='";
     slug.append(info.slug).append("'");
-    int n =
-        conn->update_some<&articles_t::tag_ids, &articles_t::title,
-                          &articles_t::abstraction, &articles_t::content,
-                          &articles_t::status, &articles_t::reviewer_id,
-                          &articles_t::review_comment, &articles_t::review_date,
-                          &articles_t::updated_at>(article, slug);
-
-    if (n == 0) {
+    auto n = co_await db_exec([&](db_conn &conn) {
+      // 文章和标签关系在同一个事务中更新，任何一步失败都回滚
+      conn->begin();
+      int count = conn->update_some<
+          &articles_t::tag_ids, &articles_t::title, &articles_t::abstraction,
+          &articles_t::content, &articles_t::status, &articles_t::reviewer_id,
+          &articles_t::review_comment, &articles_t::review_date,
+          &articles_t::updated_at>(article, slug);
+      if (count <= 0) {
+        conn->rollback();
+        return 0;
+      }
+
+      auto ids = conn->select(col(&articles_t::article_id))
+                     .from<articles_t>()
+                     .where(col(&articles_t::slug).param())
+                     .collect(info.slug);
+      if (ids.empty()) {
+        conn->rollback();
+        return 0;
+      }
+      uint64_t article_id = std::get<0>(ids.front());
+      if (!save_article_tags(conn, article_id, article.tag_ids) ||
+          !conn->commit()) {
+        CINATRA_LOG_ERROR << "更新文章标签失败: " << conn->get_last_error();
+        conn->rollback();
+        return 0;
+      }
+      search_index::instance().update(article_id, article.title,
+                                      article.abstraction, article.content);
+      return count;
+    });
+
+    if (!n.has_value() || n.value() == 0) {
       set_server_internel_error(resp);
-      return;
+      co_return;
     }
+    article_cache::instance().invalidate(info.slug);
+    count_cache::instance().invalidate();
     std::string json = make_success("修改成功");
     resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
-  void get_articles(coro_http_request &req, coro_http_response &resp) {
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
-
+  async_simple::coro::Lazy<void> get_articles(coro_http_request &req,
+                                              coro_http_response &resp) {
     // 从请求体中获取分页信息
     auto body = req.get_body();
     article_page_request page_req{};
@@ -316,7 +368,7 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数"));
-      return;
+      co_return;
     }
 
     int page = 1;
@@ -329,104 +381,60 @@ public:
       per_page = page_req.per_page;
     }
 
-    // 查询TECH_ARTICLES分组下的所有标签ID
-    auto tech_articles_tags =
-        conn->select(col(&tags_t::tag_id))
-            .from<tags_t>()
-            .where(col(&tags_t::tag_group) ==
-                   static_cast<int>(TagGroupType::TECH_ARTICLES))
-            .collect();
+    // 解析分页游标
+    auto cursor = decode_cursor(page_req.cursor);
+    if (!cursor.has_value()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("无效的分页游标"));
+      co_return;
+    }
+
+    std::vector<int> tag_ids;
+    if (page_req.tag_id > 0) {
+      tag_ids.push_back(page_req.tag_id);
+    } else {
+      // TECH_ARTICLES分组下的所有标签ID
+      tag_ids = tag_registry::instance().get_group_tag_ids(
+          TagGroupType::TECH_ARTICLES);
+    }
 
-    if (tech_articles_tags.empty()) {
+    if (tag_ids.empty()) {
       // 如果没有TECH_ARTICLES分组的标签，则返回空列表
       std::string json =
           make_data(std::vector<article_list>(), "获取文章列表成功", 0);
       resp.set_status_and_content(status_type::ok, std::move(json));
-      return;
-    }
-
-    // 构建查询条件：文章已发布且未删除，并且tag_ids包含至少一个TECH_ARTICLES分组的标签
-    auto where_cond0 = col(&articles_t::is_deleted) == 0 &&
-                       col(&articles_t::status) == PUBLISHED.data();
-
-    // 构建标签ID的OR条件
-    bool first = true;
-    decltype(where_cond0) col_tags;
-    for (const auto &tag : tech_articles_tags) {
-      int tag_id = std::get<0>(tag);
-      if (first) {
-        col_tags =
-            col(&articles_t::tag_ids).like("%" + std::to_string(tag_id) + "%");
-        first = false;
-      } else {
-        col_tags =
-            col_tags ||
-            col(&articles_t::tag_ids).like("%" + std::to_string(tag_id) + "%");
-      }
+      co_return;
     }
-    auto where_cond = where_cond0 && col_tags;
 
-    // tag_ids字段存储多个标签
-    if (page_req.tag_id > 0) {
-      where_cond = where_cond0 &&
-                   (col(&articles_t::tag_ids)
-                        .like("%" + std::to_string(page_req.tag_id) + "%"));
-    }
-    if (page_req.user_id > 0) {
-      where_cond =
-          where_cond && (col(&articles_t::author_id) == page_req.user_id);
-    }
-    // 搜索功能
-    if (!page_req.search.empty()) {
-      std::string search_pattern = "%" + page_req.search + "%";
-      where_cond = where_cond && col(&articles_t::content).like(search_pattern);
-    }
-    // 计算总记录数(根据查询条件)
-    size_t total_count =
-        conn->select(ormpp::count())
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .collect();
-
-    auto select_cond =
-        conn->select(col(&articles_t::title), col(&articles_t::abstraction),
-                     col(&articles_t::slug), col(&users_t::user_name),
-                     col(&articles_t::author_id), col(&articles_t::tag_ids),
-                     col(&articles_t::created_at), col(&articles_t::updated_at),
-                     col(&articles_t::views_count),
-                     col(&articles_t::comments_count),
-                     col(&articles_t::featured_weight))
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond);
-    size_t limit = per_page;
-    size_t offset = (page - 1) * per_page;
-    auto list = select_cond.order_by(col(&articles_t::created_at).desc())
-                    .limit(ormpp::token)
-                    .offset(ormpp::token)
-                    .collect<article_list>(limit, offset);
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      size_t limit = per_page;
+      size_t offset = (page - 1) * per_page;
+      auto result = query_articles_by_tags(
+          conn, tag_ids, page_req.user_id, page_req.search, cursor.value(),
+          limit, offset, need_count(page_req));
 
-    std::string json =
-        make_data(std::move(list), "获取文章列表成功", total_count);
-    if (json.empty()) {
-      set_server_internel_error(resp);
-      return;
-    }
-
-    resp.set_status_and_content(status_type::ok, std::move(json));
-  }
+      std::string json =
+          make_data(std::move(result.list), "获取文章列表成功",
+                    result.total_count, std::move(result.next_cursor));
+      if (json.empty()) {
+        set_server_internel_error(resp);
+        return;
+      }
 
-  void get_pending_articles(coro_http_request &req, coro_http_response &resp) {
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
+  }
 
+  async_simple::coro::Lazy<void>
+  get_pending_articles(coro_http_request &req, coro_http_response &resp) {
     size_t limit = 20; // will update, it's from web front end.
     size_t offset = 0; // will update, it's from web front end.
     std::string search;
+    std::string cursor_str;
+    bool with_count = true;
 
     // 从请求体中获取分页和搜索参数
     auto body = req.get_body();
@@ -443,58 +451,111 @@ public:
           offset = (page_req.current_page - 1) * limit;
         }
         search = page_req.search;
+        cursor_str = page_req.cursor;
+        with_count = need_count(page_req);
       }
     }
 
+    // 解析分页游标
+    auto cursor = decode_cursor(cursor_str);
+    if (!cursor.has_value()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("无效的分页游标"));
+      co_return;
+    }
+
     // 构建查询条件
-    auto where_cond = col(&articles_t::is_deleted) == 0 &&
-                      col(&articles_t::status) == PENDING_REVIEW.data();
+    std::string from = " FROM `articles` a "
+                       "INNER JOIN `users` u ON a.author_id = u.id "
+                       "WHERE a.is_deleted = 0 AND a.status = '";
+    from.append(PENDING_REVIEW).append("'");
 
-    // 搜索功能
+    // 搜索功能，从全文索引取出按相关度排序的文章ID
+    std::vector<uint64_t> matched_ids;
     if (!search.empty()) {
-      std::string search_pattern = "%" + search + "%";
-      where_cond = where_cond && col(&articles_t::content).like(search_pattern);
-    }
-
-    // 计算总记录数
-    size_t total_count =
-        conn->select(ormpp::count())
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .collect();
-
-    auto list =
-        conn->select(col(&articles_t::title), col(&articles_t::abstraction),
-                     col(&articles_t::content), col(&articles_t::slug),
-                     col(&users_t::user_name), col(&articles_t::tag_ids),
-                     col(&articles_t::created_at), col(&articles_t::updated_at),
-                     col(&articles_t::views_count),
-                     col(&articles_t::comments_count))
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .order_by(col(&articles_t::created_at).desc())
-            .limit(ormpp::token)
-            .offset(ormpp::token)
-            .collect<pending_article_list>(limit, offset);
+      matched_ids = search_index::instance().search(search);
+      if (matched_ids.empty()) {
+        std::string json = make_data(std::vector<pending_article_list>(),
+                                     "获取待审核文章列表成功", 0);
+        resp.set_status_and_content(status_type::ok, std::move(json));
+        co_return;
+      }
+    }
+
+    auto result = co_await db_exec([&](db_conn &conn) {
+      // 计算总记录数
+      int64_t total_count = -1;
+      if (!search.empty()) {
+        // 先按待审核状态过滤再截断，过滤后的数量就是总数
+        matched_ids = filter_search_results(conn, from, matched_ids,
+                                            search_index::max_search_results);
+        total_count = static_cast<int64_t>(matched_ids.size());
+        if (matched_ids.empty()) {
+          return page_result<pending_article_list>{};
+        }
+        from.append(search_filter_sql("a.article_id", matched_ids));
+      } else if (with_count) {
+        total_count =
+            count_cache::instance().get_or_load("pending", [&]() -> int64_t {
+              auto counts =
+                  conn->query_s<std::tuple<int64_t>>("SELECT COUNT(*)" + from);
+              return counts.empty() ? 0 : std::get<0>(counts.front());
+            });
+      }
+
+      // 不搜索时按(created_at, article_id)键集分页，走(status, is_deleted,
+      // created_at, article_id)索引
+      std::string sql =
+          "SELECT a.title, a.abstraction, a.content, a.slug, u.user_name, "
+          "a.tag_ids, a.created_at, a.updated_at, a.views_count, "
+          "a.comments_count, a.article_id" +
+          from;
+      if (search.empty()) {
+        sql.append(keyset_page_sql("a.created_at", "a.article_id",
+                                   cursor.value(), limit, offset));
+      } else {
+        sql.append(search_page_sql("a.article_id", matched_ids, limit, offset));
+      }
 
+      using list_row =
+          std::tuple<std::string, std::string, std::string, std::string,
+                     std::string, std::string, uint64_t, uint64_t, uint32_t,
+                     uint32_t, uint64_t>;
+      page_result<pending_article_list> list_page;
+      list_page.total_count = total_count;
+      list_page.list =
+          rows_to<pending_article_list>(conn->query_s<list_row>(sql));
+      if (search.empty() && list_page.list.size() == limit) {
+        auto &last = list_page.list.back();
+        list_page.next_cursor =
+            encode_cursor(last.created_at, last.article_id);
+      }
+      return list_page;
+    });
+    if (!result.has_value()) {
+      set_server_internel_error(resp);
+      co_return;
+    }
+
+    auto &page_data = result.value();
     std::string json =
-        make_data(std::move(list), "获取待审核文章列表成功", total_count);
+        make_data(std::move(page_data.list), "获取待审核文章列表成功",
+                  page_data.total_count, std::move(page_data.next_cursor));
     if (json.empty()) {
       set_server_internel_error(resp);
-      return;
+      co_return;
     }
 
     resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
-  void handle_review_article(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  handle_review_article(coro_http_request &req, coro_http_response &resp) {
     auto body = req.get_body();
     if (body.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，请求体不能为空"));
-      return;
+      co_return;
     }
 
     review_opinion request{};
@@ -503,88 +564,91 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，JSON格式错误"));
-      return;
-    }
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
+      co_return;
     }
     // 检查审核人是否是管理员
     auto user_id = get_user_id_from_token(req);
     if (user_id == 0) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数"));
-      return;
-    }
-    auto users_vect = conn->select(ormpp::all)
-                          .from<users_t>()
-                          .where(col(&users_t::id) == user_id)
-                          .collect();
-    if (users_vect.empty()) {
-      resp.set_status_and_content(status_type::bad_request,
-                                  make_error("无效的请求参数"));
-      return;
-    }
-
-    auto &review_user = users_vect.front();
-    if (review_user.role != "admin" && review_user.role != "superadmin") {
-      resp.set_status_and_content(
-          status_type::bad_request,
-          make_error("无效的请求参数，审核人必须是管理员"));
-      return;
-    }
-    // 检查审核人名称是否匹配
-    if (request.reviewer_name.empty() &&
-        strcmp(request.reviewer_name.data(), review_user.user_name.data()) !=
-            0) {
-      resp.set_status_and_content(status_type::bad_request,
-                                  make_error("无效的请求参数，审核人不能为空"));
-      return;
-    }
-    // 检查审核结论
-    if (request.review_status != REVIEW_ACCEPTED &&
-        request.review_status != REVIEW_REJECTED) {
-      resp.set_status_and_content(status_type::bad_request,
-                                  make_error("无效的请求参数，审核状态必须是" +
-                                             std::string(REVIEW_ACCEPTED) +
-                                             "或" +
-                                             std::string(REVIEW_REJECTED)));
-      return;
+      co_return;
     }
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      auto users_vect = conn->select(ormpp::all)
+                            .from<users_t>()
+                            .where(col(&users_t::id) == user_id)
+                            .collect();
+      if (users_vect.empty()) {
+        resp.set_status_and_content(status_type::bad_request,
+                                    make_error("无效的请求参数"));
+        return;
+      }
 
-    // 更新最近一次审核状态及意见
-    articles_t article{};
-    article.reviewer_id = review_user.id;
-    article.review_date = get_timestamp_milliseconds();
-    article.review_comment = request.review_comment;
-    article.status =
-        request.review_status == REVIEW_ACCEPTED ? PUBLISHED : REJECTED;
+      auto &review_user = users_vect.front();
+      if (review_user.role != "admin" && review_user.role != "superadmin") {
+        resp.set_status_and_content(
+            status_type::bad_request,
+            make_error("无效的请求参数，审核人必须是管理员"));
+        return;
+      }
+      // 检查审核人名称是否匹配
+      if (request.reviewer_name.empty() &&
+          strcmp(request.reviewer_name.data(), review_user.user_name.data()) !=
+              0) {
+        resp.set_status_and_content(
+            status_type::bad_request,
+            make_error("无效的请求参数，审核人不能为空"));
+        return;
+      }
+      // 检查审核结论
+      if (request.review_status != REVIEW_ACCEPTED &&
+          request.review_status != REVIEW_REJECTED) {
+        resp.set_status_and_content(
+            status_type::bad_request,
+            make_error("无效的请求参数，审核状态必须是" +
+                       std::string(REVIEW_ACCEPTED) + "或" +
+                       std::string(REVIEW_REJECTED)));
+        return;
+      }
 
-    // 使用安全的字符串拼接，避免SQL注入风险
-    std::string slug = "slug='";
-    slug.append(request.slug).append("'");
-    int n =
-        conn->update_some<&articles_t::reviewer_id, &articles_t::review_date,
-                          &articles_t::review_comment, &articles_t::status>(
-            article, slug);
-    if (n == 0) {
+      // 更新最近一次审核状态及意见
+      articles_t article{};
+      article.reviewer_id = review_user.id;
+      article.review_date = get_timestamp_milliseconds();
+      article.review_comment = request.review_comment;
+      article.status =
+          request.review_status == REVIEW_ACCEPTED ? PUBLISHED : REJECTED;
+
+      // 使用安全的字符串拼接，避免SQL注入风险
+      std::string slug = "slug='";
+      slug.append(request.slug).append("'");
+      int n =
+          conn->update_some<&articles_t::reviewer_id, &articles_t::review_date,
+                            &articles_t::review_comment, &articles_t::status>(
+              article, slug);
+      if (n == 0) {
+        set_server_internel_error(resp);
+        return;
+      }
+      article_cache::instance().invalidate(request.slug);
+      count_cache::instance().invalidate();
+      std::string json = make_success("审核成功");
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
-    std::string json = make_success("审核成功");
-    resp.set_status_and_content(status_type::ok, std::move(json));
   }
-
-  void upload_file(coro_http_request &req, coro_http_response &resp) {
-    auto info = std::any_cast<upload_file_info>(req.get_user_data());
+  async_simple::coro::Lazy<void> upload_file(coro_http_request &req,
+                                             coro_http_response &resp) {
+    auto info = get_request_data<upload_file_info>(req);
 
     // 解码base64图片数据
     auto file_data = cinatra::base64_decode(std::string(info.file_data));
     if (!file_data.has_value()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("base64图片数据解码失败"));
-      return;
+      co_return;
     }
 
     std::string &file_data_str = file_data.value();
@@ -593,52 +657,58 @@ public:
       resp.set_status_and_content(
           status_type::bad_request,
           make_error(PURECPP_ERROR_UPLOAD_FILE_SIZE_EXCEED));
-      return;
+      co_return;
     }
 
-    std::filesystem::path upload_dir = "html/uploads/articles";
-    if (!std::filesystem::exists(upload_dir)) {
-      std::filesystem::create_directories(upload_dir);
-    }
+    std::string ext(cinatra::get_extension(info.filename));
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
-    auto ext = cinatra::get_extension(info.filename);
+    // 按内容保存，相同的文件只保存一份
+    auto file_url =
+        co_await upload_store::instance().save(resp, file_data_str, ext);
+    if (!file_url) {
+      co_return;
+    }
 
-    // 生成唯一文件名
-    std::string unique_filename =
-        std::to_string(get_timestamp_milliseconds()) + std::string(ext);
-    std::filesystem::path file_path = upload_dir / unique_filename;
+    std::string filename = file_url->substr(file_url->rfind('/') + 1);
+    upload_response data{std::move(*file_url), std::move(filename)};
+    std::string json = make_data(data, "文件上传成功");
+    resp.set_status_and_content(status_type::ok, std::move(json));
+  }
 
-    // 保存文件
-    std::ofstream out_file(file_path, std::ios::binary);
-    if (!out_file) {
-      resp.set_status_and_content(status_type::internal_server_error,
-                                  make_error("保存文件失败"));
-      return;
+  /**
+   * @brief multipart上传文章图片，文件名通过?filename=传入
+   */
+  async_simple::coro::Lazy<void> upload_file_raw(coro_http_request &req,
+                                                 coro_http_response &resp) {
+    std::string ext = get_raw_upload_extension(req);
+    if (ext.empty()) {
+      resp.set_status_and_content(
+          status_type::bad_request,
+          make_error(PURECPP_ERROR_UPLOAD_RAW_INVALID_EXTENSION));
+      co_return;
     }
-    out_file.write(reinterpret_cast<const char *>(file_data_str.data()),
-                   file_data_str.size());
-    out_file.close();
 
-    // 生成文件URL
-    std::string file_url = "/uploads/articles/" + unique_filename;
-    // 构建响应
-    struct upload_response {
-      std::string url;
-      std::string filename;
-    };
+    auto file_url = co_await upload_store::instance().save(
+        req, resp, ext, MAX_FILE_SIZE, PURECPP_ERROR_UPLOAD_FILE_SIZE_EXCEED);
+    if (!file_url) {
+      co_return;
+    }
 
-    upload_response data{file_url, unique_filename};
+    std::string filename = file_url->substr(file_url->rfind('/') + 1);
+    upload_response data{std::move(*file_url), std::move(filename)};
     std::string json = make_data(data, "文件上传成功");
     resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
   // 获取用户的文章列表
-  void get_my_articles(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void> get_my_articles(coro_http_request &req,
+                                                 coro_http_response &resp) {
     auto body = req.get_body();
     if (body.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，请求体不能为空"));
-      return;
+      co_return;
     }
 
     // 从请求体中获取分页信息
@@ -648,7 +718,7 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数"));
-      return;
+      co_return;
     }
 
     int page = 1;
@@ -665,7 +735,7 @@ public:
     if (page_req.user_id == 0) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，用户ID不能为空"));
-      return;
+      co_return;
     }
 
     // 检查当前用户是否有权限查看
@@ -673,69 +743,96 @@ public:
     if (current_user_id == 0) {
       resp.set_status_and_content(status_type::unauthorized,
                                   make_error("用户未登录或登录已过期"));
-      return;
+      co_return;
     }
 
     // 只有自己可以查看自己的文章列表
     if (current_user_id != page_req.user_id) {
       resp.set_status_and_content(status_type::forbidden,
                                   make_error("没有权限查看其他用户的文章"));
-      return;
+      co_return;
     }
 
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
+    // 解析分页游标
+    auto cursor = decode_cursor(page_req.cursor);
+    if (!cursor.has_value()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("无效的分页游标"));
+      co_return;
     }
 
     // 构建查询条件
     auto where_cond = col(&articles_t::author_id) == page_req.user_id &&
                       col(&articles_t::is_deleted) == 0;
 
-    // 计算总记录数
-    size_t total_count = conn->select(ormpp::count())
-                             .from<articles_t>()
-                             .where(where_cond)
-                             .collect();
-
     // 计算分页参数
     size_t limit = per_page;
     size_t offset = (page - 1) * per_page;
 
-    // 获取用户的文章列表
-    auto articles_list =
-        conn->select(col(&articles_t::article_id), col(&articles_t::title),
-                     col(&articles_t::abstraction), col(&articles_t::content),
-                     col(&articles_t::slug), col(&articles_t::status),
-                     col(&articles_t::created_at), col(&articles_t::updated_at),
-                     col(&articles_t::views_count),
-                     col(&articles_t::comments_count),
-                     col(&articles_t::review_comment))
-            .from<articles_t>()
-            .where(where_cond)
-            .order_by(col(&articles_t::created_at).desc())
-            .limit(ormpp::token)
-            .offset(ormpp::token)
-            .collect<my_article_item>(limit, offset);
-
-    std::string json = make_data(std::move(articles_list),
-                                 "获取用户文章列表成功", total_count);
+    auto result = co_await db_exec([&](db_conn &conn) {
+      // 计算总记录数
+      int64_t total_count = -1;
+      if (need_count(page_req)) {
+        total_count = count_cache::instance().get_or_load(
+            "author:" + std::to_string(page_req.user_id), [&]() -> int64_t {
+              return conn->select(ormpp::count())
+                  .from<articles_t>()
+                  .where(where_cond)
+                  .collect();
+            });
+      }
+
+      // 获取用户的文章列表，按(created_at, article_id)键集分页，
+      // 走(author_id, is_deleted, created_at, article_id)索引
+      std::string sql =
+          "SELECT article_id, title, abstraction, content, slug, status, "
+          "created_at, updated_at, views_count, comments_count, "
+          "review_comment FROM `articles` WHERE is_deleted = 0 AND "
+          "author_id = " +
+          std::to_string(page_req.user_id) +
+          keyset_page_sql("created_at", "article_id", cursor.value(), limit,
+                          offset);
+
+      using list_row =
+          std::tuple<uint64_t, std::string, std::string, std::string,
+                     std::string, std::string, uint64_t, uint64_t, uint32_t,
+                     uint32_t, std::string>;
+      page_result<my_article_item> list_page;
+      list_page.total_count = total_count;
+      list_page.list =
+          rows_to<my_article_item>(conn->query_s<list_row>(sql));
+      if (list_page.list.size() == limit) {
+        auto &last = list_page.list.back();
+        list_page.next_cursor =
+            encode_cursor(last.created_at, last.article_id);
+      }
+      return list_page;
+    });
+    if (!result.has_value()) {
+      set_server_internel_error(resp);
+      co_return;
+    }
+
+    auto &page_data = result.value();
+    std::string json =
+        make_data(std::move(page_data.list), "获取用户文章列表成功",
+                  page_data.total_count, std::move(page_data.next_cursor));
     if (json.empty()) {
       set_server_internel_error(resp);
-      return;
+      co_return;
     }
 
     resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
   // 删除文章
-  void delete_my_article(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void> delete_my_article(coro_http_request &req,
+                                                   coro_http_response &resp) {
     auto body = req.get_body();
     if (body.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，请求体不能为空"));
-      return;
+      co_return;
     }
 
     // 解析请求参数
@@ -750,7 +847,7 @@ public:
       resp.set_status_and_content(
           status_type::bad_request,
           make_error("无效的请求参数，JSON格式错误: " + ec.message()));
-      return;
+      co_return;
     }
 
     // 验证文章ID
@@ -758,7 +855,7 @@ public:
       resp.set_status_and_content(
           status_type::bad_request,
           make_error("无效的请求参数，文章Slug不能为空"));
-      return;
+      co_return;
     }
 
     // 获取当前用户ID
@@ -766,60 +863,59 @@ public:
     if (current_user_id == 0) {
       resp.set_status_and_content(status_type::unauthorized,
                                   make_error("用户未登录或登录已过期"));
-      return;
-    }
-
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
+      co_return;
+    }
+
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 检查文章是否存在，并且是否是当前用户的文章
+      auto articles = conn->select(col(&articles_t::author_id),
+                                   col(&articles_t::article_id))
+                          .from<articles_t>()
+                          .where(col(&articles_t::slug).param() &&
+                                 col(&articles_t::is_deleted).param())
+                          .collect(request.slug, 0);
+
+      if (articles.empty()) {
+        resp.set_status_and_content(status_type::not_found,
+                                    make_error("文章不存在或已被删除"));
+        return;
+      }
 
-    // 检查文章是否存在，并且是否是当前用户的文章
-    auto articles = conn->select(col(&articles_t::author_id))
-                        .from<articles_t>()
-                        .where(col(&articles_t::slug).param() &&
-                               col(&articles_t::is_deleted).param())
-                        .collect(request.slug, 0);
+      auto [article_author_id, article_id] = articles.front();
 
-    if (articles.empty()) {
-      resp.set_status_and_content(status_type::not_found,
-                                  make_error("文章不存在或已被删除"));
-      return;
-    }
-
-    uint64_t article_author_id = std::get<0>(articles.front());
+      // 检查当前用户是否是文章作者
+      if (current_user_id != article_author_id) {
+        resp.set_status_and_content(status_type::forbidden,
+                                    make_error("没有权限删除其他用户的文章"));
+        return;
+      }
 
-    // 检查当前用户是否是文章作者
-    if (current_user_id != article_author_id) {
-      resp.set_status_and_content(status_type::forbidden,
-                                  make_error("没有权限删除其他用户的文章"));
-      return;
-    }
+      // 标记文章为已删除
+      articles_t article;
+      article.is_deleted = true;
+      article.updated_at = get_timestamp_milliseconds();
+      int n =
+          conn->update_some<&articles_t::is_deleted, &articles_t::updated_at>(
+              article, "slug='" + request.slug + "'");
+      if (n == 0) {
+        set_server_internel_error(resp);
+        return;
+      }
+      article_cache::instance().invalidate(request.slug);
+      search_index::instance().remove(article_id);
+      count_cache::instance().invalidate();
 
-    // 标记文章为已删除
-    articles_t article;
-    article.is_deleted = true;
-    article.updated_at = get_timestamp_milliseconds();
-    int n = conn->update_some<&articles_t::is_deleted, &articles_t::updated_at>(
-        article, "slug='" + request.slug + "'");
-    if (n == 0) {
+      std::string json = make_success("文章删除成功");
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
-
-    std::string json = make_success("文章删除成功");
-    resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
   // 获取社区服务文章
-  void get_community_service(coro_http_request &req, coro_http_response &resp) {
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
-
+  async_simple::coro::Lazy<void>
+  get_community_service(coro_http_request &req, coro_http_response &resp) {
     // 从请求体中获取分页信息
     auto body = req.get_body();
     article_page_request page_req{};
@@ -838,89 +934,52 @@ public:
       per_page = page_req.per_page;
     }
 
-    // 查询SERVICES分组下的所有标签ID
-    auto services_tags = conn->select(col(&tags_t::tag_id))
-                             .from<tags_t>()
-                             .where(col(&tags_t::tag_group) ==
-                                    static_cast<int>(TagGroupType::SERVICES))
-                             .collect();
+    // 解析分页游标
+    auto cursor = decode_cursor(page_req.cursor);
+    if (!cursor.has_value()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("无效的分页游标"));
+      co_return;
+    }
 
-    if (services_tags.empty()) {
+    // SERVICES分组下的所有标签ID
+    auto tag_ids =
+        tag_registry::instance().get_group_tag_ids(TagGroupType::SERVICES);
+    if (tag_ids.empty()) {
       // 如果没有SERVICES分组的标签，则返回空列表
-      std::string json =
-          make_data(std::vector<article_list>(), "获取社区服务文章列表成功", 0);
+      std::string json = make_data(std::vector<article_list>(),
+                                   "获取社区服务文章列表成功", 0);
       resp.set_status_and_content(status_type::ok, std::move(json));
-      return;
-    }
-
-    // 构建查询条件：文章已发布且未删除，并且tag_ids包含至少一个SERVICES分组的标签
-    auto where_cond = col(&articles_t::is_deleted) == 0 &&
-                      col(&articles_t::status) == PUBLISHED.data();
-
-    // 构建标签ID的OR条件
-    bool first = true;
-    decltype(where_cond) col_tags;
-    for (const auto &tag : services_tags) {
-      int tag_id = std::get<0>(tag);
-      if (first) {
-        col_tags =
-            col(&articles_t::tag_ids).like("%" + std::to_string(tag_id) + "%");
-        first = false;
-      } else {
-        col_tags =
-            col_tags ||
-            col(&articles_t::tag_ids).like("%" + std::to_string(tag_id) + "%");
-      }
+      co_return;
     }
-    where_cond = where_cond && col_tags;
 
-    // 计算总记录数
-    size_t total_count =
-        conn->select(ormpp::count())
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .collect();
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 计算分页参数
+      size_t limit = per_page;
+      size_t offset = (page - 1) * per_page;
 
-    // 计算分页参数
-    size_t limit = per_page;
-    size_t offset = (page - 1) * per_page;
+      auto result =
+          query_articles_by_tags(conn, tag_ids, 0, "", cursor.value(), limit,
+                                 offset, need_count(page_req));
 
-    // 获取社区服务文章列表
-    auto articles_list =
-        conn->select(col(&articles_t::title), col(&articles_t::abstraction),
-                     col(&articles_t::slug), col(&users_t::user_name),
-                     col(&articles_t::author_id), col(&articles_t::tag_ids),
-                     col(&articles_t::created_at), col(&articles_t::updated_at),
-                     col(&articles_t::views_count),
-                     col(&articles_t::comments_count))
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .order_by(col(&articles_t::created_at).desc())
-            .limit(ormpp::token)
-            .offset(ormpp::token)
-            .collect<article_list>(limit, offset);
-
-    std::string json = make_data(std::move(articles_list),
-                                 "获取社区服务文章列表成功", total_count);
-    if (json.empty()) {
+      std::string json =
+          make_data(std::move(result.list), "获取社区服务文章列表成功",
+                    result.total_count, std::move(result.next_cursor));
+      if (json.empty()) {
+        set_server_internel_error(resp);
+        return;
+      }
+
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
-
-    resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
   // 获取purecpp大会文章
-  void get_purecpp_conference(coro_http_request &req,
-                              coro_http_response &resp) {
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
-
+  async_simple::coro::Lazy<void>
+  get_purecpp_conference(coro_http_request &req, coro_http_response &resp) {
     // 从请求体中获取分页信息
     auto body = req.get_body();
     article_page_request page_req{};
@@ -939,88 +998,57 @@ public:
       per_page = page_req.per_page;
     }
 
-    // 查询CPP_PARTY分组下的所有标签ID
-    auto cpp_party_tags = conn->select(col(&tags_t::tag_id))
-                              .from<tags_t>()
-                              .where(col(&tags_t::tag_group) ==
-                                     static_cast<int>(TagGroupType::CPP_PARTY))
-                              .collect();
+    // 解析分页游标
+    auto cursor = decode_cursor(page_req.cursor);
+    if (!cursor.has_value()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("无效的分页游标"));
+      co_return;
+    }
 
-    if (cpp_party_tags.empty()) {
+    // CPP_PARTY分组下的所有标签ID
+    auto tag_ids =
+        tag_registry::instance().get_group_tag_ids(TagGroupType::CPP_PARTY);
+    if (tag_ids.empty()) {
       // 如果没有CPP_PARTY分组的标签，则返回空列表
       std::string json = make_data(std::vector<article_list>(),
                                    "获取purecpp大会文章列表成功", 0);
       resp.set_status_and_content(status_type::ok, std::move(json));
-      return;
-    }
-
-    // 构建查询条件：文章已发布且未删除，并且tag_ids包含至少一个CPP_PARTY分组的标签
-    auto where_cond = col(&articles_t::is_deleted) == 0 &&
-                      col(&articles_t::status) == PUBLISHED.data();
-
-    // 构建标签ID的OR条件
-    bool first = true;
-    decltype(where_cond) col_tags;
-    for (const auto &tag : cpp_party_tags) {
-      int tag_id = std::get<0>(tag);
-      if (first) {
-        col_tags =
-            col(&articles_t::tag_ids).like("%" + std::to_string(tag_id) + "%");
-        first = false;
-      } else {
-        col_tags =
-            col_tags ||
-            col(&articles_t::tag_ids).like("%" + std::to_string(tag_id) + "%");
-      }
+      co_return;
     }
-    where_cond = where_cond && col_tags;
 
-    // 计算总记录数
-    size_t total_count =
-        conn->select(ormpp::count())
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .collect();
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 计算分页参数
+      size_t limit = per_page;
+      size_t offset = (page - 1) * per_page;
 
-    // 计算分页参数
-    size_t limit = per_page;
-    size_t offset = (page - 1) * per_page;
+      auto result =
+          query_articles_by_tags(conn, tag_ids, 0, "", cursor.value(), limit,
+                                 offset, need_count(page_req));
 
-    // 获取purecpp大会文章列表
-    auto articles_list =
-        conn->select(col(&articles_t::title), col(&articles_t::abstraction),
-                     col(&articles_t::slug), col(&users_t::user_name),
-                     col(&articles_t::author_id), col(&articles_t::tag_ids),
-                     col(&articles_t::created_at), col(&articles_t::updated_at),
-                     col(&articles_t::views_count),
-                     col(&articles_t::comments_count),
-                     col(&articles_t::featured_weight))
-            .from<articles_t>()
-            .inner_join(col(&articles_t::author_id), col(&users_t::id))
-            .where(where_cond)
-            .order_by(col(&articles_t::created_at).desc())
-            .limit(ormpp::token)
-            .offset(ormpp::token)
-            .collect<article_list>(limit, offset);
-
-    std::string json = make_data(std::move(articles_list),
-                                 "获取purecpp大会文章列表成功", total_count);
-    if (json.empty()) {
+      std::string json =
+          make_data(std::move(result.list), "获取purecpp大会文章列表成功",
+                    result.total_count, std::move(result.next_cursor));
+      if (json.empty()) {
+        set_server_internel_error(resp);
+        return;
+      }
+
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
-
-    resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
   // 处理文章加精华/取消精华
-  void toggle_featured(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void> toggle_featured(coro_http_request &req,
+                                                 coro_http_response &resp) {
     auto body = req.get_body();
     if (body.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("无效的请求参数，请求体不能为空"));
-      return;
+      co_return;
     }
 
     struct toggle_featured_request {
@@ -1034,7 +1062,7 @@ public:
       resp.set_status_and_content(
           status_type::bad_request,
           make_error("无效的请求参数，JSON格式错误: " + ec.message()));
-      return;
+      co_return;
     }
 
     // 检查用户是否是管理员
@@ -1042,111 +1070,212 @@ public:
     if (user_id == 0) {
       resp.set_status_and_content(status_type::unauthorized,
                                   make_error("用户未登录或登录已过期"));
-      return;
-    }
-
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
+      co_return;
     }
 
-    auto users_vect = conn->select(ormpp::all)
-                          .from<users_t>()
-                          .where(col(&users_t::id) == user_id)
-                          .collect();
-    if (users_vect.empty()) {
-      resp.set_status_and_content(status_type::bad_request,
-                                  make_error("无效的请求参数"));
-      return;
-    }
-
-    auto &user = users_vect.front();
-    if (user.role != "admin" && user.role != "superadmin") {
-      resp.set_status_and_content(status_type::forbidden,
-                                  make_error("权限不足，只有管理员可以加精华"));
-      return;
-    }
-
-    // 获取当前文章的featured_weight值
-    auto article_vect = conn->select(col(&articles_t::tag_ids))
-                            .from<articles_t>()
-                            .where(col(&articles_t::slug) == request.slug &&
-                                   col(&articles_t::is_deleted) == 0)
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      auto users_vect = conn->select(ormpp::all)
+                            .from<users_t>()
+                            .where(col(&users_t::id) == user_id)
                             .collect();
-    if (article_vect.empty()) {
-      resp.set_status_and_content(status_type::not_found,
-                                  make_error("文章不存在或已被删除"));
-      return;
-    }
+      if (users_vect.empty()) {
+        resp.set_status_and_content(status_type::bad_request,
+                                    make_error("无效的请求参数"));
+        return;
+      }
 
-    std::string current_tag_ids = std::get<0>(article_vect.front());
-    std::string new_tag_ids = current_tag_ids;
-    if (current_tag_ids.find("108") != std::string::npos) {
-      new_tag_ids.erase(new_tag_ids.find("108"), 3);
-    } else {
-      new_tag_ids += ((current_tag_ids.length() > 0 &&
-                       current_tag_ids.at(current_tag_ids.length() - 1) == '|')
-                          ? "108"
-                          : "|108");
-    }
+      auto &user = users_vect.front();
+      if (user.role != "admin" && user.role != "superadmin") {
+        resp.set_status_and_content(
+            status_type::forbidden,
+            make_error("权限不足，只有管理员可以加精华"));
+        return;
+      }
 
-    if (new_tag_ids.length() < 3) {
-      resp.set_status_and_content(
-          status_type::bad_request,
-          make_error("文章只有‘社区精华’标签，不能取消精华，文章标签不能为空"));
-      return;
-    }
+      // 获取当前文章的featured_weight值
+      auto article_vect = conn->select(col(&articles_t::article_id),
+                                       col(&articles_t::tag_ids))
+                              .from<articles_t>()
+                              .where(col(&articles_t::slug) == request.slug &&
+                                     col(&articles_t::is_deleted) == 0)
+                              .collect();
+      if (article_vect.empty()) {
+        resp.set_status_and_content(status_type::not_found,
+                                    make_error("文章不存在或已被删除"));
+        return;
+      }
 
-    // 更新tag_ids值
-    articles_t article;
-    article.tag_ids = new_tag_ids;
-    article.updated_at = get_timestamp_milliseconds();
+      // 按标签ID切换社区精华标签，不会误匹配1080这类包含108的标签
+      uint64_t article_id = std::get<0>(article_vect.front());
+      auto tag_ids = parse_tag_ids(std::get<1>(article_vect.front()));
+      auto featured =
+          std::find(tag_ids.begin(), tag_ids.end(), featured_tag_id);
+      bool is_featured = featured == tag_ids.end();
+      if (is_featured) {
+        tag_ids.insert(
+            std::lower_bound(tag_ids.begin(), tag_ids.end(), featured_tag_id),
+            featured_tag_id);
+      } else {
+        tag_ids.erase(featured);
+      }
+
+      if (tag_ids.empty()) {
+        resp.set_status_and_content(
+            status_type::bad_request,
+            make_error("文章只有‘社区精华’标签，不能取消精华，文章标签不能为空"));
+        return;
+      }
 
-    int n = conn->update_some<&articles_t::tag_ids, &articles_t::updated_at>(
-        article, "slug='" + request.slug + "'");
+      // 更新tag_ids值，和标签关系在同一个事务中更新
+      articles_t article;
+      article.tag_ids = join_tag_ids(tag_ids, '|');
+      article.updated_at = get_timestamp_milliseconds();
+
+      conn->begin();
+      int n = conn->update_some<&articles_t::tag_ids, &articles_t::updated_at>(
+          article, "slug='" + request.slug + "'");
+      if (n == 0 || !save_article_tags(conn, article_id, article.tag_ids) ||
+          !conn->commit()) {
+        CINATRA_LOG_ERROR << "切换文章精华失败: " << conn->get_last_error();
+        conn->rollback();
+        set_server_internel_error(resp);
+        return;
+      }
+      article_cache::instance().invalidate(request.slug);
+      count_cache::instance().invalidate();
 
-    if (n == 0) {
+      std::string message = is_featured ? "文章已成功加精华" : "文章已取消精华";
+      std::string json = make_success(message);
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
-
-    std::string message = (new_tag_ids.find("108") != std::string::npos)
-                              ? "文章已成功加精华"
-                              : "文章已取消精华";
-    std::string json = make_success(message);
-    resp.set_status_and_content(status_type::ok, std::move(json));
   }
 
   // 获取统计数据
-  void get_stats(coro_http_request &req, coro_http_response &resp) {
-    auto &config = purecpp_config::get_instance();
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
+  async_simple::coro::Lazy<void> get_stats(coro_http_request &req,
+                                           coro_http_response &resp) {
+    auto config = purecpp_config::get_instance().user_cfg();
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 获取注册会员数
+      int user_count = conn->select(ormpp::count()).from<users_t>().collect();
+
+      // 获取技术文章数
+      int article_count =
+          conn->select(ormpp::count()).from<articles_t>().collect();
+
+      // 参会人数（这里使用模拟数据，实际项目中可能需要从专门的表中获取）
+      int conference_attendees = 12000;
+
+      stats_data data{.user_count =
+                          user_count + config->default_user_count,
+                      .article_count = article_count};
+
+      std::string json = make_data(data, "获取统计数据成功");
+      if (json.empty()) {
+        set_server_internel_error(resp);
+        return;
+      }
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
+  }
 
-    // 获取注册会员数
-    int user_count = conn->select(ormpp::count()).from<users_t>().collect();
-
-    // 获取技术文章数
-    int article_count =
-        conn->select(ormpp::count()).from<articles_t>().collect();
+private:
+  /**
+   * @brief 判断本次分页请求是否需要统计总数
+   * 客户端在第一页已经拿到总数，之后翻页可以设置skip_count跳过统计
+   */
+  static bool need_count(const auto &page_req) {
+    bool first_page = page_req.current_page <= 1 && page_req.cursor.empty();
+    return first_page || !page_req.skip_count;
+  }
 
-    // 参会人数（这里使用模拟数据，实际项目中可能需要从专门的表中获取）
-    int conference_attendees = 12000;
+  /**
+   * @brief 查询包含任一指定标签的已发布文章，按创建时间倒序分页
+   * 标签条件通过article_tags表的(tag_id, article_id)索引过滤，
+   * 不再对tag_ids做LIKE匹配，既避免全表扫描，也不会出现1匹配到108的问题
+   * @param author_id 作者ID，0表示所有作者
+   * @param search 搜索关键词，为空表示不搜索，搜索时按相关度排序
+   * @param cursor 分页游标，有游标时忽略offset，搜索时不使用游标
+   * @param with_count 是否统计总数，总数优先从count_cache中获取
+   * @return 总记录数、当前页的文章列表和下一页游标
+   */
+  static page_result<article_list>
+  query_articles_by_tags(db_conn &conn, const std::vector<int> &tag_ids,
+                         uint64_t author_id, const std::string &search,
+                         const page_cursor &cursor, size_t limit,
+                         size_t offset, bool with_count) {
+    std::string from =
+        " FROM `articles` a INNER JOIN `users` u ON a.author_id = u.id"
+        " WHERE a.is_deleted = 0 AND a.status = '";
+    from.append(PUBLISHED)
+        .append("' AND EXISTS (SELECT 1 FROM `article_tags` t"
+                " WHERE t.article_id = a.article_id AND t.tag_id IN (")
+        .append(join_tag_ids(tag_ids))
+        .append("))");
+    if (author_id > 0) {
+      from.append(" AND a.author_id = ").append(std::to_string(author_id));
+    }
+
+    page_result<article_list> result;
+    std::vector<uint64_t> matched_ids;
+    if (!search.empty()) {
+      // 先从全文索引取出按相关度排序的文章ID，按状态和标签过滤后再截断，
+      // 最后按主键取出文章
+      matched_ids = filter_search_results(
+          conn, from, search_index::instance().search(search),
+          search_index::max_search_results);
+      if (matched_ids.empty()) {
+        return result;
+      }
+      from.append(search_filter_sql("a.article_id", matched_ids));
+    }
+
+    std::string count_sql = "SELECT COUNT(*)" + from;
+    std::string list_sql =
+        "SELECT a.title, a.abstraction, a.slug, u.user_name, a.author_id, "
+        "a.tag_ids, a.created_at, a.updated_at, a.views_count, "
+        "a.comments_count, a.featured_weight, a.article_id" +
+        from;
+    if (search.empty()) {
+      list_sql.append(keyset_page_sql("a.created_at", "a.article_id", cursor,
+                                      limit, offset));
+    } else {
+      list_sql.append(
+          search_page_sql("a.article_id", matched_ids, limit, offset));
+    }
+
+    using count_row = std::tuple<int64_t>;
+    using list_row =
+        std::tuple<std::string, std::string, std::string, std::string,
+                   uint64_t, std::string, uint64_t, uint64_t, uint32_t,
+                   uint32_t, int, uint64_t>;
+    auto count_func = [&]() -> int64_t {
+      auto counts = conn->query_s<count_row>(count_sql);
+      return counts.empty() ? 0 : std::get<0>(counts.front());
+    };
 
-    stats_data data{.user_count =
-                        user_count + config.user_cfg_.default_user_count,
-                    .article_count = article_count};
+    result.total_count = -1;
+    if (!search.empty()) {
+      // 过滤后的搜索结果数就是总数
+      result.total_count = static_cast<int64_t>(matched_ids.size());
+    } else if (with_count) {
+      std::string key = "published|tags:" + join_tag_ids(tag_ids) +
+                        "|author:" + std::to_string(author_id);
+      result.total_count =
+          count_cache::instance().get_or_load(key, count_func);
+    }
 
-    std::string json = make_data(data, "获取统计数据成功");
-    if (json.empty()) {
-      set_server_internel_error(resp);
-      return;
+    result.list = rows_to<article_list>(conn->query_s<list_row>(list_sql));
+    if (search.empty() && result.list.size() == limit) {
+      auto &last = result.list.back();
+      result.next_cursor = encode_cursor(last.created_at, last.article_id);
     }
-    resp.set_status_and_content(status_type::ok, std::move(json));
+    return result;
   }
 };
 } // namespace purecpp
@@ -29,7 +29,7 @@ struct check_get_comments {
 
     get_comments_request request;
     request.slug = slug;
-    req.set_user_data(request);
+    set_request_data(req, request);
     return true;
   }
 };
@@ -62,7 +62,7 @@ struct check_add_comment {
       return false;
     }
 
-    req.set_user_data(request);
+    set_request_data(req, request);
     return true;
   }
 };
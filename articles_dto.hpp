@@ -8,6 +8,8 @@ struct my_article_request {
   uint64_t user_id = 0; // 0表示所有用户
   int current_page;
   int per_page;
+  std::string cursor; // 分页游标，不为空时忽略current_page
+  bool skip_count = false; // 翻到第二页以后不再统计总数，total_count返回-1
 };
 // 我的文章响应item
 struct my_article_item {
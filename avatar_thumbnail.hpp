@@ -0,0 +1,810 @@
+#pragma once
+
+// jpeglib.h依赖size_t和FILE，必须先包含cstdio
+#include <cstdio>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 解码后的RGB图像，每个像素3字节，行之间没有填充
+struct rgb_image {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// 头像缩略图生成统计
+struct thumbnail_stats {
+  uint64_t processed = 0; // 成功处理的头像数
+  uint64_t failed = 0;    // 解码或保存失败的头像数
+  uint64_t busy_us = 0;   // 工作线程处理头像的总耗时（微秒）
+};
+
+// 解码前检查图片尺寸，拒绝像素过多的图片，防止小文件解压出巨大的位图
+inline constexpr uint64_t MAX_THUMBNAIL_SOURCE_PIXELS = 16 * 1024 * 1024;
+
+namespace detail {
+
+struct jpeg_error_handler {
+  jpeg_error_mgr mgr;
+  std::jmp_buf jump;
+};
+
+inline void on_jpeg_error(j_common_ptr cinfo) {
+  auto *handler = reinterpret_cast<jpeg_error_handler *>(cinfo->err);
+  std::longjmp(handler->jump, 1);
+}
+
+// 不向stderr输出警告
+inline void on_jpeg_message(j_common_ptr) {}
+
+/**
+ * @brief 读取GIF的数据子块直到长度为0的结束块
+ * @param out 不为空时把子块的内容依次追加到out，为空时只跳过；数据被截断
+ * 时追加剩余的部分
+ * @return 是否读到结束块
+ */
+inline bool read_gif_sub_blocks(std::string_view data, size_t &pos,
+                                std::string *out) {
+  while (pos < data.size()) {
+    size_t n = uint8_t(data[pos++]);
+    if (n == 0) {
+      return true;
+    }
+    if (out != nullptr) {
+      out->append(data.substr(pos, n));
+    }
+    if (data.size() - pos < n) {
+      pos = data.size();
+      return false;
+    }
+    pos += n;
+  }
+  return false;
+}
+
+/**
+ * @brief GIF的LZW解码，输出颜色索引
+ * 码字最长12位，码表满后不再增加新码字，直到遇到清除码。数据提前结束时
+ * 保留已解码的部分，和浏览器显示不完整图片的行为一致。
+ * @param indices 大小为帧的像素数，多出的码字丢弃
+ * @return 是否解码出至少一个像素
+ */
+inline bool decode_gif_lzw(std::string_view codes, int min_code_size,
+                           std::vector<uint8_t> &indices) {
+  if (min_code_size < 1 || min_code_size > 8) {
+    return false;
+  }
+
+  constexpr int max_codes = 4096;
+  // 每个码字表示的串 = 前缀码字的串 + 最后一个字节
+  std::array<uint16_t, max_codes> prefix;
+  std::array<uint8_t, max_codes> suffix;
+  std::array<uint8_t, max_codes> first; // 串的第一个字节
+  std::array<uint8_t, max_codes> stack;
+  const int clear = 1 << min_code_size;
+  const int end = clear + 1;
+  for (int i = 0; i < clear; ++i) {
+    suffix[i] = uint8_t(i);
+    first[i] = uint8_t(i);
+  }
+
+  int code_size = min_code_size + 1;
+  int next = clear + 2;
+  int prev = -1;
+  uint32_t bits = 0;
+  int bit_count = 0;
+  size_t pos = 0;
+  size_t out = 0;
+  while (out < indices.size()) {
+    while (bit_count < code_size && pos < codes.size()) {
+      bits |= uint32_t(uint8_t(codes[pos++])) << bit_count;
+      bit_count += 8;
+    }
+    if (bit_count < code_size) {
+      break;
+    }
+    int code = int(bits & ((1u << code_size) - 1));
+    bits >>= code_size;
+    bit_count -= code_size;
+
+    if (code == clear) {
+      code_size = min_code_size + 1;
+      next = clear + 2;
+      prev = -1;
+      continue;
+    }
+    if (code == end) {
+      break;
+    }
+    if (prev < 0) {
+      if (code >= clear) {
+        return false;
+      }
+      indices[out++] = uint8_t(code);
+      prev = code;
+      continue;
+    }
+    if (code > next) {
+      return false;
+    }
+
+    // 从后往前展开码字，code == next时是前一个串加上它的第一个字节
+    int cur = code;
+    size_t depth = 0;
+    if (cur == next) {
+      stack[depth++] = first[prev];
+      cur = prev;
+    }
+    while (cur >= clear) {
+      stack[depth++] = suffix[cur];
+      cur = prefix[cur];
+    }
+    stack[depth++] = uint8_t(cur);
+    while (depth > 0 && out < indices.size()) {
+      indices[out++] = stack[--depth];
+    }
+
+    if (next < max_codes) {
+      prefix[next] = uint16_t(prev);
+      suffix[next] = uint8_t(cur);
+      first[next] = first[prev];
+      ++next;
+      if (next == (1 << code_size) && code_size < 12) {
+        ++code_size;
+      }
+    }
+    prev = code;
+  }
+  return out > 0;
+}
+
+// 交错存储的GIF中第row个解码行在图像中的行号
+inline int gif_interlaced_row(int row, int height) {
+  static constexpr int starts[] = {0, 4, 2, 1};
+  static constexpr int steps[] = {8, 8, 4, 2};
+  for (int pass = 0; pass < 4; ++pass) {
+    int rows = (height - starts[pass] + steps[pass] - 1) / steps[pass];
+    if (row < rows) {
+      return starts[pass] + row * steps[pass];
+    }
+    row -= rows;
+  }
+  return height;
+}
+
+} // namespace detail
+
+/**
+ * @brief 解码JPEG
+ * 利用libjpeg在DCT域缩小的能力，按1/2、1/4、1/8解码，保证短边不小于
+ * min_side，大图只需解码很少的像素。
+ * @return 是否解码成功
+ */
+inline bool decode_jpeg(std::string_view data, int min_side,
+                        rgb_image &image) {
+  jpeg_decompress_struct cinfo;
+  detail::jpeg_error_handler err;
+  cinfo.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = detail::on_jpeg_error;
+  err.mgr.output_message = detail::on_jpeg_message;
+  if (setjmp(err.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  auto *input = reinterpret_cast<const unsigned char *>(data.data());
+  jpeg_mem_src(&cinfo, const_cast<unsigned char *>(input),
+               static_cast<unsigned long>(data.size()));
+  if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK ||
+      uint64_t(cinfo.image_width) * cinfo.image_height >
+          MAX_THUMBNAIL_SOURCE_PIXELS) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  unsigned int shorter = std::min(cinfo.image_width, cinfo.image_height);
+  unsigned int denom = 8;
+  while (denom > 1 && shorter / denom < unsigned(min_side)) {
+    denom /= 2;
+  }
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = denom;
+  cinfo.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+
+  image.width = static_cast<int>(cinfo.output_width);
+  image.height = static_cast<int>(cinfo.output_height);
+  size_t stride = size_t(image.width) * 3;
+  image.pixels.resize(stride * image.height);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = image.pixels.data() + stride * cinfo.output_scanline;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+/**
+ * @brief 解码PNG，透明部分合成到白色背景上
+ * @return 是否解码成功
+ */
+inline bool decode_png(std::string_view data, rgb_image &image) {
+  png_image png{};
+  png.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&png, data.data(), data.size())) {
+    return false;
+  }
+  if (uint64_t(png.width) * png.height > MAX_THUMBNAIL_SOURCE_PIXELS) {
+    png_image_free(&png);
+    return false;
+  }
+
+  png.format = PNG_FORMAT_RGB;
+  image.width = static_cast<int>(png.width);
+  image.height = static_cast<int>(png.height);
+  image.pixels.resize(PNG_IMAGE_SIZE(png));
+  png_color background{255, 255, 255};
+  if (!png_image_finish_read(&png, &background, image.pixels.data(), 0,
+                             nullptr)) {
+    png_image_free(&png);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 解码GIF的第一帧，透明部分和第一帧没有覆盖的部分为白色背景
+ * 动图只取第一帧，和大多数客户端未加载完成时显示的画面一致。
+ * @return 是否解码成功
+ */
+inline bool decode_gif(std::string_view data, rgb_image &image) {
+  auto byte_at = [data](size_t i) { return uint8_t(data[i]); };
+  auto word_at = [data](size_t i) {
+    return int(uint8_t(data[i])) | int(uint8_t(data[i + 1])) << 8;
+  };
+  if (data.size() < 13 ||
+      (data.substr(0, 6) != "GIF87a" && data.substr(0, 6) != "GIF89a")) {
+    return false;
+  }
+
+  int width = word_at(6);
+  int height = word_at(8);
+  uint8_t screen_flags = byte_at(10);
+  size_t pos = 13;
+  std::string_view global_colors;
+  if (screen_flags & 0x80) {
+    size_t n = size_t(3) << ((screen_flags & 0x07) + 1);
+    if (data.size() - pos < n) {
+      return false;
+    }
+    global_colors = data.substr(pos, n);
+    pos += n;
+  }
+
+  int transparent = -1;
+  while (pos < data.size()) {
+    uint8_t block = byte_at(pos++);
+    if (block == 0x21) {
+      // 扩展块，只关心图形控制扩展中的透明色
+      if (pos >= data.size()) {
+        return false;
+      }
+      uint8_t label = byte_at(pos++);
+      if (label == 0xF9 && data.size() - pos > 5 && byte_at(pos) == 4) {
+        transparent = (byte_at(pos + 1) & 0x01) ? byte_at(pos + 4) : -1;
+      }
+      if (!detail::read_gif_sub_blocks(data, pos, nullptr)) {
+        return false;
+      }
+      continue;
+    }
+    if (block != 0x2C || data.size() - pos < 9) {
+      // 结束块或损坏的数据，都没有读到第一帧
+      return false;
+    }
+
+    int left = word_at(pos);
+    int top = word_at(pos + 2);
+    int frame_width = word_at(pos + 4);
+    int frame_height = word_at(pos + 6);
+    uint8_t frame_flags = byte_at(pos + 8);
+    pos += 9;
+    std::string_view colors = global_colors;
+    if (frame_flags & 0x80) {
+      size_t n = size_t(3) << ((frame_flags & 0x07) + 1);
+      if (data.size() - pos < n) {
+        return false;
+      }
+      colors = data.substr(pos, n);
+      pos += n;
+    }
+    if (width == 0 || height == 0) {
+      width = left + frame_width;
+      height = top + frame_height;
+    }
+    if (colors.empty() || pos >= data.size() || width == 0 || height == 0 ||
+        uint64_t(width) * height > MAX_THUMBNAIL_SOURCE_PIXELS ||
+        uint64_t(frame_width) * frame_height > MAX_THUMBNAIL_SOURCE_PIXELS) {
+      return false;
+    }
+
+    int min_code_size = byte_at(pos++);
+    std::string codes;
+    // 数据被截断时和浏览器一样显示已有的部分
+    detail::read_gif_sub_blocks(data, pos, &codes);
+    // 没有解码到的像素按透明处理
+    std::vector<uint8_t> indices(size_t(frame_width) * frame_height,
+                                 uint8_t(std::max(transparent, 0)));
+    if (!detail::decode_gif_lzw(codes, min_code_size, indices)) {
+      return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels.assign(size_t(width) * height * 3, 255);
+    size_t palette_size = colors.size() / 3;
+    bool interlaced = frame_flags & 0x40;
+    for (int row = 0; row < frame_height; ++row) {
+      int y = top + (interlaced ? detail::gif_interlaced_row(row, frame_height)
+                                : row);
+      if (y >= height || left >= width) {
+        continue;
+      }
+      const uint8_t *src = indices.data() + size_t(row) * frame_width;
+      uint8_t *dst = image.pixels.data() + (size_t(y) * width + left) * 3;
+      for (int x = 0; x < frame_width && left + x < width; ++x, dst += 3) {
+        if (src[x] == transparent || src[x] >= palette_size) {
+          continue;
+        }
+        std::memcpy(dst, colors.data() + size_t(src[x]) * 3, 3);
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief 居中裁剪成正方形并缩放到size x size
+ * 缩小时输出像素取对应源区域的平均值，比最近邻清晰且没有锯齿；源图比
+ * 目标小时退化为最近邻放大。
+ */
+inline rgb_image resize_square(const rgb_image &src, int size) {
+  int side = std::min(src.width, src.height);
+  int x_offset = (src.width - side) / 2;
+  int y_offset = (src.height - side) / 2;
+
+  // 每个输出像素对应的源区域[begin, end)
+  auto make_bounds = [side, size](int offset) {
+    std::vector<int> bounds(size + 1);
+    for (int i = 0; i <= size; ++i) {
+      bounds[i] = offset + int(int64_t(i) * side / size);
+    }
+    return bounds;
+  };
+  auto xs = make_bounds(x_offset);
+  auto ys = make_bounds(y_offset);
+
+  rgb_image dst;
+  dst.width = size;
+  dst.height = size;
+  dst.pixels.resize(size_t(size) * size * 3);
+  size_t src_stride = size_t(src.width) * 3;
+  uint8_t *out = dst.pixels.data();
+  for (int oy = 0; oy < size; ++oy) {
+    int y0 = ys[oy];
+    int y1 = std::max(ys[oy + 1], y0 + 1);
+    for (int ox = 0; ox < size; ++ox) {
+      int x0 = xs[ox];
+      int x1 = std::max(xs[ox + 1], x0 + 1);
+      uint32_t r = 0, g = 0, b = 0;
+      for (int y = y0; y < y1; ++y) {
+        const uint8_t *p = src.pixels.data() + src_stride * y + size_t(x0) * 3;
+        for (int x = x0; x < x1; ++x, p += 3) {
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+      }
+      uint32_t count = uint32_t(y1 - y0) * uint32_t(x1 - x0);
+      *out++ = uint8_t((r + count / 2) / count);
+      *out++ = uint8_t((g + count / 2) / count);
+      *out++ = uint8_t((b + count / 2) / count);
+    }
+  }
+  return dst;
+}
+
+/**
+ * @brief 编码为JPEG，启用哈夫曼表优化减小文件
+ * @return 是否编码成功
+ */
+inline bool encode_jpeg(const rgb_image &image, int quality,
+                        std::string &out) {
+  jpeg_compress_struct cinfo;
+  detail::jpeg_error_handler err;
+  unsigned char *buffer = nullptr;
+  unsigned long size = 0;
+  cinfo.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = detail::on_jpeg_error;
+  err.mgr.output_message = detail::on_jpeg_message;
+  if (setjmp(err.jump)) {
+    jpeg_destroy_compress(&cinfo);
+    std::free(buffer);
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &buffer, &size);
+  cinfo.image_width = static_cast<JDIMENSION>(image.width);
+  cinfo.image_height = static_cast<JDIMENSION>(image.height);
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  cinfo.optimize_coding = TRUE;
+  jpeg_start_compress(&cinfo, TRUE);
+
+  size_t stride = size_t(image.width) * 3;
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<uint8_t *>(image.pixels.data()) +
+                   stride * cinfo.next_scanline;
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  out.assign(reinterpret_cast<const char *>(buffer), size);
+  jpeg_destroy_compress(&cinfo);
+  std::free(buffer);
+  return true;
+}
+
+/**
+ * @brief 头像缩略图生成器
+ * 上传头像后把原图交给后台线程池，解码PNG/JPEG/GIF并生成128、64、32像素
+ * 的正方形JPEG缩略图，保存在头像目录的thumbnails子目录下，如
+ * avatars/thumbnails/avatar_1_1700000000000_64.jpg。GIF动图取第一帧。
+ * 页面通过/uploads/avatars/xxx.png?size=64请求缩略图，还没有生成时返回
+ * 原图。已生成缩略图的原图记录在内存中，查找时不访问文件系统。
+ */
+class avatar_thumbnailer {
+public:
+  // 从大到小生成，小尺寸由上一级缩略图缩小得到
+  static constexpr std::array<int, 3> sizes = {128, 64, 32};
+  static constexpr int jpeg_quality = 85;
+  static constexpr size_t max_queue_size = 1024;
+
+  avatar_thumbnailer(const avatar_thumbnailer &) = delete;
+  avatar_thumbnailer &operator=(const avatar_thumbnailer &) = delete;
+
+  static avatar_thumbnailer &instance() {
+    static avatar_thumbnailer instance;
+    return instance;
+  }
+
+  /**
+   * @brief 启动工作线程
+   * @param threads 线程数，至少1个
+   */
+  void start(int threads) {
+    std::lock_guard lock(thd_mutex_);
+    if (!workers_.empty()) {
+      return;
+    }
+
+    stop_ = false;
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+      workers_.emplace_back([this] { run(); });
+    }
+  }
+
+  /**
+   * @brief 停止工作线程，队列中未处理的头像丢弃，下次请求时重新提交
+   */
+  void stop() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (workers_.empty()) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+    workers_.clear();
+    queue_.clear();
+    pending_.clear();
+  }
+
+  /**
+   * @brief 提交原图，排队或正在处理的原图不会重复提交
+   * @return 是否加入队列，不支持的格式、队列已满时返回false
+   */
+  bool submit(const std::string &source_path) {
+    if (!is_supported(source_path)) {
+      return false;
+    }
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (workers_.empty() || queue_.size() >= max_queue_size ||
+          failed_.contains(source_path) ||
+          !pending_.insert(source_path).second) {
+        return false;
+      }
+      queue_.push_back(source_path);
+    }
+    cv_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief 记录目录下已有缩略图的头像，为还没有缩略图的头像生成缩略图，
+   * 用于启动时加载已生成的缩略图和升级后补齐旧头像
+   * 超出队列长度的头像在第一次被请求时再提交
+   */
+  void backfill(const std::string &dir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    size_t submitted = 0;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      if (!it->is_regular_file(ec)) {
+        continue;
+      }
+      std::string path = it->path().string();
+      if (!is_supported(path)) {
+        continue;
+      }
+      if (fs::exists(thumbnail_path(path, sizes.back()), ec)) {
+        // 最小的缩略图最后生成，存在时全部尺寸都已生成
+        std::lock_guard lock(thd_mutex_);
+        generated_.insert(std::move(path));
+      } else if (submit(path)) {
+        ++submitted;
+      }
+    }
+    if (submitted > 0) {
+      CINATRA_LOG_INFO << "avatar thumbnails backfill queued: " << submitted;
+    }
+  }
+
+  /**
+   * @brief 把请求的尺寸向上取到最近的缩略图尺寸
+   * @return 缩略图尺寸，比最大的缩略图还大时返回0，应使用原图
+   */
+  static int snap_size(int requested) {
+    int best = 0;
+    for (int size : sizes) {
+      if (size >= requested) {
+        best = size;
+      }
+    }
+    return best;
+  }
+
+  /**
+   * @brief 原图对应的缩略图路径
+   * avatars/avatar_1_2.png -> avatars/thumbnails/avatar_1_2_64.jpg
+   */
+  static std::string thumbnail_path(const std::string &source_path,
+                                    int size) {
+    std::filesystem::path source(source_path);
+    auto name =
+        source.stem().string() + "_" + std::to_string(size) + ".jpg";
+    return (source.parent_path() / "thumbnails" / name).string();
+  }
+
+  /**
+   * @brief 查找原图对应尺寸的缩略图
+   * 只查内存中的记录，在io线程上调用不会阻塞。缩略图还没有生成时提交原图，
+   * 返回std::nullopt，调用者先返回原图；原图不存在时由工作线程记为失败，
+   * 不会反复提交。
+   * @param requested 页面需要的尺寸（像素）
+   */
+  std::optional<std::string> find(const std::string &source_path,
+                                  int requested) {
+    int size = snap_size(requested);
+    if (size == 0 || !is_supported(source_path)) {
+      return std::nullopt;
+    }
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (generated_.contains(source_path)) {
+        return thumbnail_path(source_path, size);
+      }
+    }
+    submit(source_path);
+    return std::nullopt;
+  }
+
+  static bool is_supported(std::string_view path) {
+    std::string ext(cinatra::get_extension(path));
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".gif";
+  }
+
+  /**
+   * @brief 解码图片并编码全部尺寸的缩略图，不读写文件
+   * 按文件头而不是扩展名判断格式。
+   * @param encoded 依次保存sizes中各尺寸的JPEG数据
+   * @return 是否全部生成成功
+   */
+  static bool render(std::string_view data,
+                     std::array<std::string, sizes.size()> &encoded) {
+    rgb_image source;
+    bool decoded = false;
+    if (data.size() >= 8 && png_sig_cmp(reinterpret_cast<png_const_bytep>(
+                                            data.data()),
+                                        0, 8) == 0) {
+      decoded = decode_png(data, source);
+    } else if (data.size() >= 3 && uint8_t(data[0]) == 0xFF &&
+               uint8_t(data[1]) == 0xD8 && uint8_t(data[2]) == 0xFF) {
+      decoded = decode_jpeg(data, sizes.front(), source);
+    } else if (data.starts_with("GIF8")) {
+      decoded = decode_gif(data, source);
+    }
+    if (!decoded || source.width == 0 || source.height == 0) {
+      return false;
+    }
+
+    int source_side = std::min(source.width, source.height);
+    rgb_image previous;
+    const rgb_image *from = &source;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      int size = sizes[i];
+      rgb_image thumbnail = resize_square(*from, size);
+      if (!encode_jpeg(thumbnail, jpeg_quality, encoded[i])) {
+        return false;
+      }
+
+      // 上一级是缩小得到的才继续用它缩小，否则从原图采样
+      if (source_side >= size) {
+        previous = std::move(thumbnail);
+        from = &previous;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief 同步生成一个原图的全部缩略图
+   * 先写临时文件再重命名，读取缩略图的请求不会读到写了一半的文件。
+   * @return 是否全部生成成功
+   */
+  static bool generate(const std::string &source_path) {
+    std::string data;
+    {
+      std::ifstream file(source_path, std::ios::binary);
+      if (!file) {
+        return false;
+      }
+      data.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+    }
+
+    std::array<std::string, sizes.size()> encoded;
+    if (!render(data, encoded)) {
+      return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(
+        std::filesystem::path(thumbnail_path(source_path, sizes.front()))
+            .parent_path(),
+        ec);
+
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      auto path = thumbnail_path(source_path, sizes[i]);
+      auto tmp_path = path + ".tmp";
+      {
+        std::ofstream out_file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out_file.write(encoded[i].data(), encoded[i].size())) {
+          std::filesystem::remove(tmp_path, ec);
+          return false;
+        }
+      }
+      std::filesystem::rename(tmp_path, path, ec);
+      if (ec) {
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  thumbnail_stats stats() const {
+    return {processed_.load(std::memory_order_relaxed),
+            failed_count_.load(std::memory_order_relaxed),
+            busy_us_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  avatar_thumbnailer() = default;
+  ~avatar_thumbnailer() { stop(); }
+
+  void run() {
+    std::unique_lock lock(thd_mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) {
+        break;
+      }
+      std::string source_path = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+
+      auto start = std::chrono::steady_clock::now();
+      bool ok = generate(source_path);
+      auto cost = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      busy_us_.fetch_add(uint64_t(cost), std::memory_order_relaxed);
+      if (ok) {
+        processed_.fetch_add(1, std::memory_order_relaxed);
+        CINATRA_LOG_INFO << "avatar thumbnails generated: " << source_path
+                         << ", cost: " << cost << "us";
+      } else {
+        failed_count_.fetch_add(1, std::memory_order_relaxed);
+        CINATRA_LOG_WARNING << "avatar thumbnails failed: " << source_path;
+      }
+
+      lock.lock();
+      pending_.erase(source_path);
+      if (ok) {
+        generated_.insert(source_path);
+      } else {
+        // 无法解码的图片不再重复提交
+        if (failed_.size() >= max_queue_size) {
+          failed_.clear();
+        }
+        failed_.insert(source_path);
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::deque<std::string> queue_;
+  std::unordered_set<std::string> pending_;   // 排队或正在处理的原图
+  std::unordered_set<std::string> failed_;    // 处理失败的原图
+  std::unordered_set<std::string> generated_; // 已生成全部缩略图的原图
+
+  std::atomic<uint64_t> processed_{0};
+  std::atomic<uint64_t> failed_count_{0};
+  std::atomic<uint64_t> busy_us_{0};
+};
+
+} // namespace purecpp
@@ -0,0 +1,170 @@
+// 头像缩略图生成的吞吐量基准测试
+// 用法: bench_avatar_thumbnail [原图边长] [每个线程处理的头像数]
+// 分别用PNG、JPEG、GIF原图调用avatar_thumbnailer::render，不读写文件，
+// 输出单线程和全部核心并行时每秒处理的头像数以及每个核心的吞吐量。
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "avatar_thumbnail.hpp"
+
+using namespace purecpp;
+
+namespace {
+
+// 带渐变和条纹的测试图，比纯色图更接近真实头像的压缩率
+rgb_image make_source(int side) {
+  rgb_image image;
+  image.width = side;
+  image.height = side;
+  image.pixels.resize(size_t(side) * side * 3);
+  uint8_t *p = image.pixels.data();
+  for (int y = 0; y < side; ++y) {
+    for (int x = 0; x < side; ++x) {
+      *p++ = uint8_t(x * 255 / side);
+      *p++ = uint8_t(y * 255 / side);
+      *p++ = uint8_t(((x / 16 + y / 16) % 2) * 128 + (x ^ y) % 64);
+    }
+  }
+  return image;
+}
+
+std::string make_png(const rgb_image &image) {
+  png_image png{};
+  png.version = PNG_IMAGE_VERSION;
+  png.width = image.width;
+  png.height = image.height;
+  png.format = PNG_FORMAT_RGB;
+  png_alloc_size_t size = 0;
+  png_image_write_to_memory(&png, nullptr, &size, 0, image.pixels.data(), 0,
+                            nullptr);
+  std::string out(size, '\0');
+  png_image_write_to_memory(&png, out.data(), &size, 0, image.pixels.data(),
+                            0, nullptr);
+  out.resize(size);
+  return out;
+}
+
+// 用3-3-2位的固定调色板编码GIF，LZW码表不增长，每254个码字插入一个清除码
+std::string make_gif(const rgb_image &image) {
+  auto put_word = [](std::string &out, int value) {
+    out.push_back(char(value & 0xFF));
+    out.push_back(char(value >> 8));
+  };
+
+  std::string out = "GIF89a";
+  put_word(out, image.width);
+  put_word(out, image.height);
+  out.push_back(char(0xF7)); // 全局调色板，256色
+  out.push_back(0);
+  out.push_back(0);
+  for (int i = 0; i < 256; ++i) {
+    out.push_back(char((i >> 5) * 255 / 7));
+    out.push_back(char(((i >> 2) & 7) * 255 / 7));
+    out.push_back(char((i & 3) * 255 / 3));
+  }
+  out.push_back(0x2C);
+  put_word(out, 0);
+  put_word(out, 0);
+  put_word(out, image.width);
+  put_word(out, image.height);
+  out.push_back(0);
+  out.push_back(8); // 最小码长
+
+  constexpr int clear = 256;
+  constexpr int end = 257;
+  std::string codes;
+  uint32_t bits = 0;
+  int bit_count = 0;
+  auto put_code = [&](int code) {
+    bits |= uint32_t(code) << bit_count;
+    bit_count += 9;
+    while (bit_count >= 8) {
+      codes.push_back(char(bits & 0xFF));
+      bits >>= 8;
+      bit_count -= 8;
+    }
+  };
+
+  const uint8_t *p = image.pixels.data();
+  size_t pixels = size_t(image.width) * image.height;
+  for (size_t i = 0; i < pixels; ++i, p += 3) {
+    if (i % 254 == 0) {
+      put_code(clear);
+    }
+    put_code((p[0] & 0xE0) | ((p[1] >> 3) & 0x1C) | (p[2] >> 6));
+  }
+  put_code(end);
+  if (bit_count > 0) {
+    codes.push_back(char(bits & 0xFF));
+  }
+
+  for (size_t pos = 0; pos < codes.size(); pos += 255) {
+    size_t n = std::min<size_t>(255, codes.size() - pos);
+    out.push_back(char(n));
+    out.append(codes, pos, n);
+  }
+  out.push_back(0);
+  out.push_back(0x3B);
+  return out;
+}
+
+// 每个线程处理iterations个头像，返回总耗时（秒）
+double run(const std::string &data, int threads, int iterations) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&data, iterations] {
+      std::array<std::string, avatar_thumbnailer::sizes.size()> encoded;
+      for (int i = 0; i < iterations; ++i) {
+        if (!avatar_thumbnailer::render(data, encoded)) {
+          std::fprintf(stderr, "render failed\n");
+          std::exit(1);
+        }
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int side = argc > 1 ? std::atoi(argv[1]) : 512;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 50;
+  int cores = std::max(1, int(std::thread::hardware_concurrency()));
+
+  auto source = make_source(side);
+  std::string jpeg;
+  encode_jpeg(source, 90, jpeg);
+  std::pair<const char *, std::string> inputs[] = {
+      {"png", make_png(source)},
+      {"jpeg", std::move(jpeg)},
+      {"gif", make_gif(source)},
+  };
+
+  std::printf("source: %dx%d, iterations: %d, cores: %d\n", side, side,
+              iterations, cores);
+  std::printf("%-6s %10s %12s %12s %14s\n", "format", "bytes", "1 thread/s",
+              "all cores/s", "per core/s");
+  for (auto &[name, data] : inputs) {
+    run(data, 1, 2); // 预热
+    double single = iterations / run(data, 1, iterations);
+    double all = double(iterations) * cores / run(data, cores, iterations);
+    std::printf("%-6s %10zu %12.1f %12.1f %14.1f\n", name, data.size(), single,
+                all, all / cores);
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+// cleanup_markdown的基准测试
+// 用法: bench_markdown_stripper [文章大小KB] [调用次数]
+// 用段落、标题、列表、链接、强调、行内代码和代码块拼出一篇文章，对比
+// markdown_stripper和原来逐个执行std::regex_replace的实现的耗时。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <string_view>
+
+#include "user_aspects.hpp"
+
+using namespace purecpp;
+
+namespace {
+
+// 原来的cleanup_markdown
+std::string regex_cleanup_markdown(const std::string &markdown_text) {
+  std::string text = markdown_text;
+  text = std::regex_replace(text, std::regex("!\\[(.*?)\\]\\(.*?\\)"), "$1");
+  text = std::regex_replace(text, std::regex("\\[(.*?)\\]\\(.*?\\)"), "$1");
+  text = std::regex_replace(text, std::regex("(\\*\\*|__)(.*?)\\1"), "$2");
+  text = std::regex_replace(text, std::regex("(\\*|_)(.*?)\\1"), "$2");
+  text = std::regex_replace(text, std::regex("```[\\s\\S]*?```"), "");
+  text = std::regex_replace(text, std::regex("`(.*?)`"), "$1");
+  text = std::regex_replace(text, std::regex("^#+\\s*"), "");
+  text = std::regex_replace(text, std::regex("^[*-+]\\s"), "");
+  text = std::regex_replace(text, std::regex("^>\\s"), "");
+  text = std::regex_replace(text, std::regex("\\n+"), " ");
+  return text;
+}
+
+std::string make_article(size_t size) {
+  static constexpr std::string_view section =
+      "## 协程与异步IO\n\n"
+      "purecpp基于**cinatra**和*async_simple*，详见[文档](http://purecpp.cn)"
+      "和![架构图](/img/arch.png)。\n"
+      "- 使用`co_await`等待数据库操作\n"
+      "- 文件读写在__独立线程池__中执行\n"
+      "> 注意：不要在io线程上执行_阻塞_操作。\n\n"
+      "```cpp\n"
+      "async_simple::coro::Lazy<void> handle(coro_http_request &req) {\n"
+      "  auto rows = co_await db_exec([](db_conn &conn) { return 1; });\n"
+      "}\n"
+      "```\n\n";
+  std::string article;
+  while (article.size() < size) {
+    article.append(section);
+  }
+  return article;
+}
+
+template <typename Func> double us_per_call(int rounds, Func func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    func();
+  }
+  std::chrono::duration<double, std::micro> cost =
+      std::chrono::steady_clock::now() - start;
+  return cost.count() / rounds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t size_kb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+  std::string article = make_article(size_kb * 1024);
+  std::string out;
+  size_t checksum = 0;
+  double stripper = us_per_call(rounds * 10, [&] {
+    cleanup_markdown(article, out);
+    checksum += out.size();
+  });
+  double regex = us_per_call(rounds, [&] {
+    checksum += regex_cleanup_markdown(article).size();
+  });
+
+  std::printf("article: %zu bytes, plain text: %zu bytes\n", article.size(),
+              out.size());
+  std::printf("regex:    %10.1f us/op\n", regex);
+  std::printf("stripper: %10.1f us/op\n", stripper);
+  std::printf("speedup:  %10.1fx (checksum %zu)\n", regex / stripper,
+              checksum);
+  return 0;
+}
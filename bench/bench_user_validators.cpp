@@ -0,0 +1,85 @@
+// 注册校验函数的微基准测试
+// 用法: bench_user_validators [每组输入的调用次数]
+// 对比字符类扫描的is_valid_username、validate_email_format、
+// validate_password_complexity和基于std::regex的实现，输出每次调用的平均
+// 耗时。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "user_aspects.hpp"
+
+using namespace purecpp;
+
+namespace {
+
+// 防止编译器把没有使用结果的调用优化掉
+volatile bool sink;
+
+template <typename Func>
+double ns_per_call(const std::vector<std::string> &inputs, int rounds,
+                   Func func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) {
+    for (const auto &input : inputs) {
+      sink = func(input);
+    }
+  }
+  std::chrono::duration<double, std::nano> cost =
+      std::chrono::steady_clock::now() - start;
+  return cost.count() / (double(rounds) * inputs.size());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+  std::vector<std::string> usernames = {"purecpp", "user_name-01",
+                                        "invalid name", "qicosmos2024"};
+  std::vector<std::string> emails = {"someone@example.com",
+                                     "first.last+tag@mail.example.org",
+                                     "invalid@domain", "no-at-sign.com"};
+  std::vector<std::string> passwords = {"Abc12345", "password", "PASSWORD1",
+                                        "Xy9-long-passphrase"};
+
+  std::printf("%-10s %14s %14s\n", "validator", "regex ns/op",
+              "scanner ns/op");
+
+  // 原来check_user_name每次调用都构造正则
+  double regex_username = ns_per_call(usernames, rounds / 10, [](auto &s) {
+    return std::regex_match(s, std::regex("^[a-zA-Z0-9_-]+$"));
+  });
+  double scan_username = ns_per_call(
+      usernames, rounds, [](auto &s) { return is_valid_username(s); });
+  std::printf("%-10s %14.1f %14.1f\n", "username", regex_username,
+              scan_username);
+
+  // 原来validate_email_format用静态正则，但每次复制成std::string
+  double regex_email = ns_per_call(emails, rounds, [](auto &s) {
+    static const std::regex email_regex(
+        R"([a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,})");
+    return std::regex_match(std::string{s}, email_regex);
+  });
+  double scan_email = ns_per_call(
+      emails, rounds, [](auto &s) { return validate_email_format(s).first; });
+  std::printf("%-10s %14.1f %14.1f\n", "email", regex_email, scan_email);
+
+  double regex_password = ns_per_call(passwords, rounds, [](auto &s) {
+    static const std::regex upper("[A-Z]");
+    static const std::regex lower("[a-z]");
+    static const std::regex digit("[0-9]");
+    return s.size() >= 6 && s.size() <= 20 && std::regex_search(s, upper) &&
+           std::regex_search(s, lower) && std::regex_search(s, digit);
+  });
+  double scan_password = ns_per_call(passwords, rounds, [](auto &s) {
+    return validate_password_complexity(s).first;
+  });
+  std::printf("%-10s %14.1f %14.1f\n", "password", regex_password,
+              scan_password);
+  return 0;
+}
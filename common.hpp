@@ -1,9 +1,14 @@
 #pragma once
+#include <charconv>
 #include <chrono>
+#include <optional>
 #include <string_view>
+#include <tuple>
+#include <vector>
 
 #include "config.hpp"
 #include "entity.hpp"
+#include "request_context.hpp"
 #include "user_dto.hpp"
 #include <cinatra.hpp>
 #include <cinatra/smtp_client.hpp>
@@ -71,7 +76,9 @@ inline std::string make_error(std::string_view err_msg, int code = 400) {
 }
 
 template <typename T>
-inline std::string make_data(T t, std::string msg = "", int total_count = 0) {
+inline std::string
+make_data(T t, std::string msg = "", int total_count = 0,
+          std::optional<std::string> next_cursor = std::nullopt) {
   rest_response<T> data{};
   data.success = true;
   data.message = std::move(msg);
@@ -80,6 +87,7 @@ inline std::string make_data(T t, std::string msg = "", int total_count = 0) {
   auto now = get_timestamp_milliseconds();
   data.timestamp = std::to_string(now);
   data.total_count = total_count;
+  data.next_cursor = std::move(next_cursor);
 
   std::string json;
   try {
@@ -92,6 +100,124 @@ inline std::string make_data(T t, std::string msg = "", int total_count = 0) {
   return json;
 }
 
+/**
+ * @brief 键集分页游标，对应列表的排序字段(created_at, id)
+ * 客户端拿到的是不透明的base64字符串，翻页时原样传回
+ */
+struct page_cursor {
+  uint64_t created_at = 0;
+  uint64_t id = 0;
+};
+
+inline std::string encode_cursor(uint64_t created_at, uint64_t id) {
+  return cinatra::base64_encode(std::to_string(created_at) + ":" +
+                                std::to_string(id));
+}
+
+/**
+ * @brief 解析分页游标
+ * @return 游标为空时返回page_cursor{}，格式错误时返回std::nullopt
+ */
+inline std::optional<page_cursor> decode_cursor(std::string_view cursor) {
+  if (cursor.empty()) {
+    return page_cursor{};
+  }
+
+  auto raw = cinatra::base64_decode(cursor);
+  if (!raw.has_value()) {
+    return std::nullopt;
+  }
+
+  std::string_view str = raw.value();
+  auto pos = str.find(':');
+  if (pos == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  page_cursor result;
+  auto created_at = str.substr(0, pos);
+  auto id = str.substr(pos + 1);
+  auto [p1, ec1] = std::from_chars(
+      created_at.data(), created_at.data() + created_at.size(),
+      result.created_at);
+  auto [p2, ec2] =
+      std::from_chars(id.data(), id.data() + id.size(), result.id);
+  if (ec1 != std::errc{} || p1 != created_at.data() + created_at.size() ||
+      ec2 != std::errc{} || p2 != id.data() + id.size() || result.id == 0) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+/**
+ * @brief 生成按(created_at, id)倒序的分页sql片段
+ * 有游标时用键集条件定位，翻到多深都只扫描一页的数据；
+ * 没有游标时退回到LIMIT/OFFSET，兼容按页码翻页
+ * @param created_col 创建时间列名
+ * @param id_col 主键列名
+ * @param cursor 分页游标，id为0表示没有游标
+ * @return 形如" AND (...) ORDER BY ... LIMIT ..."的sql片段，拼在WHERE条件后
+ */
+inline std::string keyset_page_sql(std::string_view created_col,
+                                   std::string_view id_col,
+                                   const page_cursor &cursor, size_t limit,
+                                   size_t offset) {
+  std::string sql;
+  if (cursor.id > 0) {
+    std::string created_at = std::to_string(cursor.created_at);
+    sql.append(" AND (")
+        .append(created_col)
+        .append(" < ")
+        .append(created_at)
+        .append(" OR (")
+        .append(created_col)
+        .append(" = ")
+        .append(created_at)
+        .append(" AND ")
+        .append(id_col)
+        .append(" < ")
+        .append(std::to_string(cursor.id))
+        .append("))");
+  }
+
+  sql.append(" ORDER BY ")
+      .append(created_col)
+      .append(" DESC, ")
+      .append(id_col)
+      .append(" DESC LIMIT ")
+      .append(std::to_string(limit));
+  if (cursor.id == 0 && offset > 0) {
+    sql.append(" OFFSET ").append(std::to_string(offset));
+  }
+  return sql;
+}
+
+/**
+ * @brief 一页列表数据
+ */
+template <typename T> struct page_result {
+  int64_t total_count = 0; // -1表示本次没有统计总数
+  std::vector<T> list;
+  std::optional<std::string> next_cursor; // 不满一页时没有下一页
+};
+
+/**
+ * @brief 把query_s查询出来的tuple逐行转换成结构体，字段按顺序对应
+ */
+template <typename T, typename Tuple>
+inline std::vector<T> rows_to(std::vector<Tuple> rows) {
+  std::vector<T> result;
+  result.reserve(rows.size());
+  for (auto &row : rows) {
+    result.push_back(std::apply(
+        [](auto &&...fields) {
+          return T{std::forward<decltype(fields)>(fields)...};
+        },
+        std::move(row)));
+  }
+  return result;
+}
+
 inline void set_server_internel_error(auto &resp) {
   resp.set_status_and_content(
       status_type::internal_server_error,
@@ -198,12 +324,11 @@ inline async_simple::coro::Lazy<bool> send_email(const std::string &to_email,
                                                  const std::string &subject,
                                                  const std::string &content,
                                                  bool is_html = true) {
-  auto &conf = purecpp_config::get_instance();
-  auto &user_conf = conf.user_cfg_;
+  auto user_conf = purecpp_config::get_instance().user_cfg();
 
   // 检查必要的配置是否存在
-  if (user_conf.smtp_host.empty() || user_conf.smtp_user.empty() ||
-      user_conf.smtp_password.empty()) {
+  if (user_conf->smtp_host.empty() || user_conf->smtp_user.empty() ||
+      user_conf->smtp_password.empty()) {
     CINATRA_LOG_ERROR << "SMTP配置不完整";
     co_return false;
   }
@@ -211,8 +336,8 @@ inline async_simple::coro::Lazy<bool> send_email(const std::string &to_email,
   try {
     // 创建SMTP客户端（使用SSL）
     auto client = smtp::get_smtp_client(coro_io::get_global_executor());
-    bool r = co_await client.connect(user_conf.smtp_host,
-                                     std::to_string(user_conf.smtp_port));
+    bool r = co_await client.connect(user_conf->smtp_host,
+                                     std::to_string(user_conf->smtp_port));
     // 连接SMTP服务器
     if (!r) {
       CINATRA_LOG_ERROR << "SMTP连接失败";
@@ -221,9 +346,9 @@ inline async_simple::coro::Lazy<bool> send_email(const std::string &to_email,
 
     // 设置邮件内容
     cinatra::smtp::email_data email_data;
-    email_data.user_name = user_conf.smtp_user;
-    email_data.auth_pwd = user_conf.smtp_password;
-    email_data.from_email = user_conf.smtp_from_email;
+    email_data.user_name = user_conf->smtp_user;
+    email_data.auth_pwd = user_conf->smtp_password;
+    email_data.from_email = user_conf->smtp_from_email;
     email_data.to_email.push_back(to_email);
     email_data.subject = subject;
 
@@ -247,11 +372,10 @@ inline async_simple::coro::Lazy<bool> send_email(const std::string &to_email,
 // 发送邮箱验证邮件
 inline async_simple::coro::Lazy<bool>
 send_verify_email(const std::string &email, const std::string &token) {
-  auto &conf = purecpp_config::get_instance();
-  auto &user_conf = conf.user_cfg_;
+  auto user_conf = purecpp_config::get_instance().user_cfg();
   // 构建验证链接
   std::string verify_link =
-      user_conf.web_server_url + "/verify_email.html?token=" + token;
+      user_conf->web_server_url + "/verify_email.html?token=" + token;
 
   try {
     // 构建邮件内容
@@ -278,13 +402,12 @@ send_verify_email(const std::string &email, const std::string &token) {
 // 发送密码重置邮件
 inline async_simple::coro::Lazy<bool>
 send_reset_email(const std::string &email, const std::string &token) {
-  auto &conf = purecpp_config::get_instance();
-  auto &user_conf = conf.user_cfg_;
+  auto user_conf = purecpp_config::get_instance().user_cfg();
 
   try {
     // 生成重置链接
     std::string reset_link =
-        user_conf.web_server_url + "/reset_password.html?token=" + token;
+        user_conf->web_server_url + "/reset_password.html?token=" + token;
 
     // 构建邮件内容
     std::string email_content;
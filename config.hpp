@@ -1,10 +1,20 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cinatra.hpp>
+#include <condition_variable>
+#include <csignal>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iguana/json_reader.hpp>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace purecpp {
@@ -79,13 +89,56 @@ struct user_config {
 
   // 等级规则配置
   std::vector<level_rule> level_rules; // 等级规则配置，按等级从小到大排序
+
+  // 缓存配置
+  int32_t article_cache_max_mb = 64; // 文章详情缓存内存上限（MB），0表示关闭
+  int32_t views_flush_interval_seconds = 10; // 浏览量写回数据库的间隔（秒）
+  int32_t count_cache_ttl_seconds = 30; // 列表总数缓存有效期（秒），0表示关闭
+
+  // 限流计数配置
+  int32_t rate_limit_max_keys = 65536; // 最多记录的(客户端, 规则)数
+  int32_t rate_limit_sweep_interval_seconds = 30; // 清理过期记录的间隔（秒）
+  // 多个进程共享限流计数的文件（如/dev/shm/purecpp_rate_limit），为空时
+  // 计数只在当前进程内有效
+  std::string rate_limit_shm_path;
+
+  // 已退出登录的令牌黑名单文件，重启后重新加载
+  std::string token_blacklist_file = "data/token_blacklist.txt";
+  // 清理黑名单中已过期令牌的间隔（秒）
+  int32_t token_blacklist_sweep_interval_seconds = 60;
+
+  // 检查配置文件是否修改、是否收到SIGHUP的间隔（秒）
+  int32_t config_watch_interval_seconds = 5;
+  // 检查html目录下静态文件是否修改的间隔（秒）
+  int32_t static_watch_interval_seconds = 5;
+  // 生成头像缩略图的线程数
+  int32_t avatar_thumbnail_threads = 2;
+
+  // 上传文件写盘配置
+  int32_t upload_io_threads = 2; // 执行写盘的线程数
+  int32_t file_read_threads = 2; // 读取要发送的文件的线程数，和写盘分开
+  // 同时写入的上传文件数上限，超过时返回503
+  int32_t upload_max_inflight_writes = 64;
+  // 落盘策略：none不主动fsync，file写完fsync文件，full再fsync所在目录
+  std::string upload_fsync_policy = "none";
 }; // 用户配置结构体，包含安全设置和邮件服务器配置
 
 /**
  * @brief 配置类，用于存储全局配置
+ * 配置以不可变快照的形式发布：读取方通过user_cfg()拿到当前快照的
+ * shared_ptr，在使用期间持有它；重新加载时解析出一份新快照整体替换，
+ * 已拿到旧快照的请求继续使用旧值，不存在读到一半被修改的情况。
+ * 收到SIGHUP或配置文件修改时间变化时由后台线程重新加载。
+ * 限流规则、经验奖励、等级规则、令牌密钥和有效期等每次使用时读取的配置
+ * 重新加载后立即生效；缓存大小、限流计数上限、共享内存路径等只在启动时
+ * 读取的配置需要重启。
  */
 class purecpp_config {
 public:
+  // 重新加载成功后的回调，参数为旧快照和新快照
+  using reload_callback =
+      std::function<void(const user_config &, const user_config &)>;
+
   purecpp_config(const purecpp_config &) = delete;
   purecpp_config(purecpp_config &&) = delete;
   purecpp_config &operator=(const purecpp_config &) = delete;
@@ -98,29 +151,152 @@ public:
   }
 
   /**
-   * @brief 从JSON文件加载配置
+   * @brief 从JSON文件加载配置，解析失败时保留当前配置
    * @param filename JSON文件名
+   * @return 是否加载成功
    */
-  void load_config(const std::string &filename) {
-    // 从JSON文件加载配置
-    std::ifstream file(filename, std::ios::in);
+  bool load_config(const std::string &filename) {
+    {
+      std::lock_guard lock(thd_mutex_);
+      filename_ = filename;
+    }
+
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(filename, ec);
+
+    // 从JSON文件加载配置，读取整个文件，不限制大小
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
     if (!file.is_open()) {
       CINATRA_LOG_ERROR << "no config file";
+      return false;
+    }
+    std::string json((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+
+    auto cfg = std::make_shared<user_config>();
+    try {
+      iguana::from_json(*cfg, json);
+    } catch (const std::exception &e) {
+      CINATRA_LOG_ERROR << "parse config file " << filename
+                        << " failed: " << e.what();
+      return false;
+    }
+
+    user_cfg_.store(std::move(cfg), std::memory_order_release);
+    if (!ec) {
+      std::lock_guard lock(thd_mutex_);
+      mtime_ = mtime;
+    }
+    return true;
+  }
+
+  /**
+   * @brief 获取当前配置快照，使用期间持有返回的shared_ptr
+   */
+  std::shared_ptr<const user_config> user_cfg() const {
+    return user_cfg_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief 启动配置监视线程
+   * @param interval_seconds 检查间隔（秒）
+   * @param on_reload 重新加载成功后调用，在监视线程中执行
+   */
+  void start_watch(int interval_seconds, reload_callback on_reload) {
+    std::lock_guard lock(thd_mutex_);
+    if (thd_.joinable()) {
       return;
     }
 
-    std::string json;
-    json.resize(4096);
-    file.read(json.data(), json.size());
-    iguana::from_json(user_cfg_, json);
+    std::signal(SIGHUP, on_sighup);
+    stop_ = false;
+    interval_ = std::chrono::seconds(std::max(interval_seconds, 1));
+    on_reload_ = std::move(on_reload);
+    thd_ = std::thread([this] {
+      std::unique_lock lock(thd_mutex_);
+      while (!stop_) {
+        cv_.wait_for(lock, interval_, [this] { return stop_; });
+        if (stop_) {
+          break;
+        }
+        lock.unlock();
+        check_reload();
+        lock.lock();
+      }
+    });
+  }
+
+  void stop_watch() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (!thd_.joinable()) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thd_.join();
   }
 
 private:
   // ======== 私有构造/析构：保证单例 ========
-  purecpp_config() = default;
-  ~purecpp_config() = default;
+  purecpp_config() : user_cfg_(std::make_shared<const user_config>()) {}
+  ~purecpp_config() { stop_watch(); }
 
-public:
-  user_config user_cfg_;
+  static void on_sighup(int) {
+    reload_requested_.store(true, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 收到SIGHUP或文件修改时间变化时重新加载
+   */
+  void check_reload() {
+    std::string filename;
+    std::filesystem::file_time_type last_mtime;
+    {
+      std::lock_guard lock(thd_mutex_);
+      filename = filename_;
+      last_mtime = mtime_;
+    }
+    if (filename.empty()) {
+      return;
+    }
+
+    bool requested = reload_requested_.exchange(false);
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(filename, ec);
+    if (!requested && (ec || mtime == last_mtime)) {
+      return;
+    }
+
+    auto old_cfg = user_cfg();
+    if (!load_config(filename)) {
+      // 解析失败时记录修改时间，文件再次修改前不重复报错
+      if (!ec) {
+        std::lock_guard lock(thd_mutex_);
+        mtime_ = mtime;
+      }
+      return;
+    }
+    CINATRA_LOG_INFO << "config reloaded: " << filename
+                     << (requested ? " (SIGHUP)" : " (file changed)");
+    if (on_reload_) {
+      on_reload_(*old_cfg, *user_cfg());
+    }
+  }
+
+  std::atomic<std::shared_ptr<const user_config>> user_cfg_;
+
+  inline static std::atomic<bool> reload_requested_{false};
+  static_assert(std::atomic<bool>::is_always_lock_free);
+
+  std::string filename_;
+  std::filesystem::file_time_type mtime_{};
+  reload_callback on_reload_;
+  std::thread thd_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  std::chrono::seconds interval_{5};
+  bool stop_ = false;
 };
 } // namespace purecpp
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "common.hpp"
+
+namespace purecpp {
+
+/**
+ * @brief 列表总记录数缓存
+ * 以规范化后的查询条件为键缓存count结果，条目在ttl后过期。
+ * 文章发布、删除等会影响列表的操作调用invalidate，通过递增版本号让所有
+ * 条目一次性失效，不需要逐个匹配受影响的查询条件。
+ */
+class count_cache {
+public:
+  count_cache(const count_cache &) = delete;
+  count_cache &operator=(const count_cache &) = delete;
+
+  static count_cache &instance() {
+    static count_cache instance;
+    return instance;
+  }
+
+  /**
+   * @brief 设置缓存有效期
+   * @param ttl_seconds 有效期（秒），0表示不缓存
+   */
+  void init(int ttl_seconds) {
+    ttl_ms_ = ttl_seconds > 0 ? uint64_t(ttl_seconds) * 1000 : 0;
+  }
+
+  /**
+   * @brief 查询缓存，未命中或已过期时调用load_func重新统计
+   * @param key 规范化后的查询条件
+   * @param load_func 返回总记录数的可调用对象
+   */
+  template <typename Func>
+  int64_t get_or_load(const std::string &key, Func &&load_func) {
+    uint64_t now = get_timestamp_milliseconds();
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    {
+      std::lock_guard lock(mutex_);
+      auto it = entries_.find(key);
+      if (it != entries_.end() && it->second.generation == generation &&
+          it->second.expire_at > now) {
+        return it->second.count;
+      }
+    }
+
+    int64_t count = load_func();
+    if (ttl_ms_ == 0) {
+      return count;
+    }
+
+    std::lock_guard lock(mutex_);
+    if (entries_.size() >= max_entries) {
+      // 条件组合太多时(比如各种搜索词)直接清空，避免无限增长
+      entries_.clear();
+    }
+    entries_[key] = {count, now + ttl_ms_, generation};
+    return count;
+  }
+
+  /**
+   * @brief 使所有缓存的总数失效
+   */
+  void invalidate() { generation_.fetch_add(1, std::memory_order_release); }
+
+private:
+  count_cache() = default;
+
+  static constexpr size_t max_entries = 4096;
+
+  struct entry {
+    int64_t count;
+    uint64_t expire_at;
+    uint64_t generation;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, entry> entries_;
+  std::atomic<uint64_t> generation_{0};
+  uint64_t ttl_ms_ = 0;
+};
+
+} // namespace purecpp
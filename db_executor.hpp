@@ -0,0 +1,129 @@
+#pragma once
+
+#include "entity.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+using db_conn = std::shared_ptr<dbng<mysql>>;
+
+/**
+ * @brief 数据库执行器
+ * ormpp的调用都是同步阻塞的，直接在http的io线程中执行会导致一个慢查询
+ * 阻塞该线程上的所有连接。这里用一个独立的线程池来执行数据库操作，
+ * 线程数与数据库连接池大小(db_conn_num)保持一致。
+ */
+class db_executor {
+public:
+  db_executor(const db_executor &) = delete;
+  db_executor &operator=(const db_executor &) = delete;
+
+  static db_executor &instance() {
+    static db_executor instance;
+    return instance;
+  }
+
+  /**
+   * @brief 启动数据库线程池
+   * @param thread_num 线程数，一般等于数据库连接数
+   */
+  void init(size_t thread_num) {
+    std::lock_guard lock(mutex_);
+    if (pool_ != nullptr) {
+      return;
+    }
+
+    thread_num = std::max<size_t>(thread_num, 1);
+    pool_ = std::make_unique<coro_io::io_context_pool>(thread_num);
+    thd_ = std::thread([this] { pool_->run(); });
+    CINATRA_LOG_INFO << "db executor started, thread num: " << thread_num;
+  }
+
+  /**
+   * @brief 停止数据库线程池，等待已提交的任务执行完成
+   */
+  void stop() {
+    std::lock_guard lock(mutex_);
+    if (pool_ == nullptr) {
+      return;
+    }
+
+    pool_->stop();
+    if (thd_.joinable()) {
+      thd_.join();
+    }
+    pool_ = nullptr;
+  }
+
+  coro_io::ExecutorWrapper<> *get_executor() {
+    if (pool_ == nullptr) {
+      // 没有显式初始化时按cpu核数启动
+      init(std::thread::hardware_concurrency());
+    }
+    return pool_->get_executor();
+  }
+
+private:
+  db_executor() = default;
+  ~db_executor() { stop(); }
+
+  std::unique_ptr<coro_io::io_context_pool> pool_;
+  std::thread thd_;
+  std::mutex mutex_;
+};
+
+/**
+ * @brief 在数据库线程池上执行func，协程挂起直到func执行完成
+ * @param func 无参的可调用对象，内部自行获取数据库连接
+ * @return func的返回值
+ */
+template <typename Func>
+inline async_simple::coro::Lazy<std::invoke_result_t<Func>>
+db_post(Func func) {
+  auto result = co_await coro_io::post(std::move(func),
+                                       db_executor::instance().get_executor());
+  co_return std::move(result).value();
+}
+
+/**
+ * @brief 获取一个数据库连接并在数据库线程池上执行func
+ * 用法: auto r = co_await db_exec([&](db_conn &conn) { return ...; });
+ * 回调的参数需要写成db_conn而不是auto，否则conn->select(...).from<T>()
+ * 是依赖名，需要加template关键字
+ * @param func 参数为db_conn的可调用对象
+ * @return func返回void时返回bool，获取连接失败为false；
+ *         否则返回std::optional，获取连接失败为std::nullopt
+ */
+template <typename Func> inline auto db_exec(Func func) {
+  using result_type = std::invoke_result_t<Func, db_conn &>;
+
+  if constexpr (std::is_void_v<result_type>) {
+    return db_post([func = std::move(func)]() mutable {
+      auto conn = connection_pool<dbng<mysql>>::instance().get();
+      if (conn == nullptr) {
+        return false;
+      }
+      func(conn);
+      return true;
+    });
+  } else {
+    return db_post(
+        [func = std::move(func)]() mutable -> std::optional<result_type> {
+          auto conn = connection_pool<dbng<mysql>>::instance().get();
+          if (conn == nullptr) {
+            return std::nullopt;
+          }
+          return func(conn);
+        });
+  }
+}
+
+} // namespace purecpp
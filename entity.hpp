@@ -282,6 +282,15 @@ struct tags_t {
 };
 constexpr std::string_view get_alias_struct_name(tags_t *) { return "tags"; }
 
+// 文章和标签的多对多关系，替代按tag_ids做LIKE匹配
+struct article_tags_t {
+  uint64_t article_id; // 外键
+  int tag_id;          // 外键
+};
+constexpr std::string_view get_alias_struct_name(article_tags_t *) {
+  return "article_tags";
+}
+
 template <typename T> struct rest_response {
   bool success = true;
   std::string message;
@@ -289,6 +298,7 @@ template <typename T> struct rest_response {
   std::string timestamp;
   int code = 200;
   int total_count = 0; // 总记录数，用于分页
+  std::optional<std::string> next_cursor; // 下一页游标，没有下一页时为空
   std::optional<T> data;
 };
 } // namespace purecpp
\ No newline at end of file
@@ -60,6 +60,12 @@ inline constexpr std::string_view PURECPP_ERROR_UPLOAD_FILE_SIZE_EXCEED =
     "上传文件大小不能超过4MB";
 inline constexpr std::string_view PURECPP_ERROR_UPLOAD_FILE_INVALID_CONTENT =
     "上传文件包含危险内容";
+inline constexpr std::string_view PURECPP_ERROR_UPLOAD_RAW_INVALID_EXTENSION =
+    "上传文件格式错误，仅支持jpg, jpeg, png, gif图片";
+inline constexpr std::string_view PURECPP_ERROR_UPLOAD_NOT_MULTIPART =
+    "请使用multipart/form-data上传文件";
+inline constexpr std::string_view PURECPP_ERROR_UPLOAD_BUSY =
+    "上传的文件过多，请稍后再试";
 
 // 注册相关错误
 inline constexpr std::string_view PURECPP_ERROR_REGISTER_INFO_EMPTY =
@@ -0,0 +1,331 @@
+#pragma once
+
+#include "entity.hpp"
+#include "user_experience.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 一次经验值奖励
+struct experience_event {
+  uint64_t user_id;
+  int64_t experience;
+  ExperienceChangeType change_type;
+  std::string description;
+  uint64_t created_at; // 产生奖励的时间，写入经验值记录
+};
+
+struct experience_reward_stats {
+  uint64_t applied = 0; // 已写入数据库的奖励数
+  uint64_t skipped = 0; // 超过每日上限或当天已领取而跳过的奖励数
+  uint64_t failed = 0;  // 写入数据库失败的奖励数
+  uint64_t dropped = 0; // 队列已满而丢弃的奖励数
+  uint64_t batches = 0; // 提交的事务数
+};
+
+/**
+ * @brief 经验值奖励队列
+ * 登录、注册、发文章、发评论成功后只把奖励放入内存队列，不在返回响应
+ * 前访问数据库。后台线程每次取出最多batch_size个奖励，在一个事务中
+ * 处理：锁定相关用户行，一条分组查询得到各用户当天已获得的经验值和是否
+ * 已领取登录奖励，再用一条UPDATE更新所有用户的经验值和等级、一条多行
+ * INSERT写入经验值记录。
+ * 整批失败时逐个奖励重试，避免一个异常的奖励连累同批的其它奖励。
+ * 停止时处理完队列中剩余的奖励再退出。
+ */
+class experience_reward_queue {
+public:
+  static constexpr size_t batch_size = 200;
+  static constexpr size_t max_queue_size = 10000;
+
+  experience_reward_queue(const experience_reward_queue &) = delete;
+  experience_reward_queue &operator=(const experience_reward_queue &) = delete;
+
+  static experience_reward_queue &instance() {
+    static experience_reward_queue instance;
+    return instance;
+  }
+
+  /**
+   * @brief 启动后台线程
+   */
+  void start() {
+    std::lock_guard lock(thd_mutex_);
+    if (thd_.joinable()) {
+      return;
+    }
+
+    stop_ = false;
+    thd_ = std::thread([this] { run(); });
+  }
+
+  /**
+   * @brief 停止后台线程，队列中剩余的奖励处理完后返回
+   */
+  void stop() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (!thd_.joinable()) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thd_.join();
+  }
+
+  /**
+   * @brief 放入一个奖励
+   * @return 是否放入，队列已满时返回false
+   */
+  bool emit(uint64_t user_id, int64_t experience,
+            ExperienceChangeType change_type, std::string description) {
+    if (user_id == 0 || experience <= 0) {
+      return false;
+    }
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (queue_.size() >= max_queue_size) {
+        uint64_t dropped = dropped_.fetch_add(1, std::memory_order_relaxed);
+        CINATRA_LOG_WARNING << "experience reward queue full, user: "
+                            << user_id << ", dropped: " << dropped + 1;
+        return false;
+      }
+      queue_.push_back({user_id, experience, change_type,
+                        std::move(description), get_timestamp_milliseconds()});
+    }
+    cv_.notify_one();
+    return true;
+  }
+
+  size_t pending() {
+    std::lock_guard lock(thd_mutex_);
+    return queue_.size();
+  }
+
+  experience_reward_stats stats() const {
+    return {applied_.load(std::memory_order_relaxed),
+            skipped_.load(std::memory_order_relaxed),
+            failed_.load(std::memory_order_relaxed),
+            dropped_.load(std::memory_order_relaxed),
+            batches_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  experience_reward_queue() = default;
+  ~experience_reward_queue() { stop(); }
+
+  // 处理一批奖励时每个用户的状态
+  struct user_state {
+    uint64_t experience = 0;   // 当前经验值
+    int64_t earned_today = 0;  // 当天已获得的经验值
+    bool logged_in = false;    // 当天是否已领取登录奖励
+    bool changed = false;
+  };
+
+  void run() {
+    std::unique_lock lock(thd_mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break;
+      }
+
+      std::vector<experience_event> batch;
+      size_t n = std::min(queue_.size(), batch_size);
+      batch.reserve(n);
+      for (size_t i = 0; i < n; ++i) {
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+      lock.unlock();
+      flush(batch);
+      lock.lock();
+    }
+  }
+
+  void flush(const std::vector<experience_event> &batch) {
+    auto conn = connection_pool<dbng<mysql>>::instance().get();
+    if (conn == nullptr) {
+      CINATRA_LOG_WARNING << "apply experience rewards failed, no db "
+                             "connection, rewards: "
+                          << batch.size();
+      failed_.fetch_add(batch.size(), std::memory_order_relaxed);
+      return;
+    }
+
+    if (apply(conn, batch) || batch.size() == 1) {
+      return;
+    }
+    for (const auto &event : batch) {
+      apply(conn, {event});
+    }
+  }
+
+  /**
+   * @brief 在一个事务中处理一批奖励
+   * @return 是否提交成功，失败时已回滚
+   */
+  bool apply(db_conn &conn, const std::vector<experience_event> &events) {
+    std::string ids;
+    std::unordered_set<uint64_t> seen;
+    for (const auto &event : events) {
+      if (seen.insert(event.user_id).second) {
+        if (!ids.empty()) {
+          ids.append(",");
+        }
+        ids.append(std::to_string(event.user_id));
+      }
+    }
+
+    auto fail = [&] {
+      conn->rollback();
+      CINATRA_LOG_ERROR << "apply experience rewards failed, rewards: "
+                        << events.size();
+      if (events.size() == 1) {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+      }
+      return false;
+    };
+
+    conn->begin();
+    // 锁定用户行，读出的经验值在事务提交前不会被其它事务修改
+    auto user_rows = conn->query_s<std::tuple<uint64_t, uint64_t>>(
+        "SELECT id, experience FROM `users` WHERE id IN (" + ids +
+        ") FOR UPDATE");
+    // 查不到的用户不在users中，对应的奖励跳过
+    std::unordered_map<uint64_t, user_state> users;
+    for (auto &[id, experience] : user_rows) {
+      users[id].experience = experience;
+    }
+
+    // 每日上限只统计获得的经验值，购买、赠送等扣减的记录不抵消已获得的奖励
+    uint64_t today_start = user_level_t::get_today_start_timestamp();
+    auto today_rows =
+        conn->query_s<std::tuple<uint64_t, int64_t, int64_t>>(
+            "SELECT user_id, CAST(SUM(CASE WHEN experience_change > 0 THEN "
+            "experience_change ELSE 0 END) AS SIGNED), "
+            "CAST(SUM(change_type = ?) AS SIGNED) FROM "
+            "`user_experience_detail` WHERE user_id IN (" +
+                ids + ") AND created_at >= ? GROUP BY user_id",
+            static_cast<int>(ExperienceChangeType::DAILY_LOGIN), today_start);
+    for (auto &[id, earned, logins] : today_rows) {
+      auto it = users.find(id);
+      if (it != users.end()) {
+        it->second.earned_today = earned;
+        it->second.logged_in = logins > 0;
+      }
+    }
+
+    auto config = purecpp_config::get_instance().user_cfg();
+    auto daily_limit =
+        static_cast<int64_t>(config->experience_limits.daily_total_limit);
+
+    std::vector<user_experience_detail_t> details;
+    uint64_t skipped = 0;
+    for (const auto &event : events) {
+      auto it = users.find(event.user_id);
+      if (it == users.end()) {
+        ++skipped;
+        continue;
+      }
+      auto &user = it->second;
+      bool is_login = event.change_type == ExperienceChangeType::DAILY_LOGIN;
+      if ((is_login && user.logged_in) ||
+          user.earned_today + event.experience > daily_limit) {
+        ++skipped;
+        continue;
+      }
+
+      user.experience += event.experience;
+      user.earned_today += event.experience;
+      user.logged_in = user.logged_in || is_login;
+      user.changed = true;
+      details.push_back({.user_id = event.user_id,
+                         .change_type = event.change_type,
+                         .experience_change = event.experience,
+                         .balance_after_experience = user.experience,
+                         .description = event.description,
+                         .created_at = event.created_at});
+    }
+
+    if (!details.empty()) {
+      if (!conn->execute(build_update_sql(users)) ||
+          conn->insert(details) != static_cast<int>(details.size())) {
+        return fail();
+      }
+    }
+    if (!conn->commit()) {
+      return fail();
+    }
+
+    applied_.fetch_add(details.size(), std::memory_order_relaxed);
+    skipped_.fetch_add(skipped, std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief 生成批量更新语句
+   * UPDATE users SET experience = CASE id WHEN 1 THEN 160 ... END,
+   * level = CASE id WHEN 1 THEN 2 ... END WHERE id IN (1,...)
+   */
+  static std::string
+  build_update_sql(const std::unordered_map<uint64_t, user_state> &users) {
+    std::string experience_cases;
+    std::string level_cases;
+    std::string ids;
+    for (const auto &[id, user] : users) {
+      if (!user.changed) {
+        continue;
+      }
+      std::string when = " WHEN " + std::to_string(id) + " THEN ";
+      experience_cases.append(when).append(std::to_string(user.experience));
+      level_cases.append(when).append(std::to_string(static_cast<int>(
+          user_level_t::calculate_level(user.experience))));
+      if (!ids.empty()) {
+        ids.append(",");
+      }
+      ids.append(std::to_string(id));
+    }
+
+    std::string sql = "UPDATE `users` SET experience = CASE id";
+    sql.append(experience_cases)
+        .append(" END, level = CASE id")
+        .append(level_cases)
+        .append(" END WHERE id IN (")
+        .append(ids)
+        .append(")");
+    return sql;
+  }
+
+  std::deque<experience_event> queue_;
+
+  std::atomic<uint64_t> applied_{0};
+  std::atomic<uint64_t> skipped_{0};
+  std::atomic<uint64_t> failed_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> batches_{0};
+
+  std::thread thd_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+} // namespace purecpp
@@ -7,19 +7,35 @@
 
 #include <cinatra.hpp>
 
+#include <pthread.h>
+#include <signal.h>
+
 #include <algorithm>
+#include <charconv>
 #include <filesystem>
 #include <iguana/json_reader.hpp>
 #include <iguana/json_writer.hpp>
 #include <random>
 #include <vector>
 
+#include "article_cache.hpp"
+#include "article_tags.hpp"
 #include "articles.hpp"
 #include "articles_aspects.hpp"
 #include "articles_comment.hpp"
+#include "avatar_thumbnail.hpp"
+#include "count_cache.hpp"
+#include "db_executor.hpp"
 #include "entity.hpp"
+#include "experience_reward_queue.hpp"
+#include "file_response.hpp"
+#include "file_sink.hpp"
+#include "jwt_token.hpp"
 #include "rate_limiter.hpp"
+#include "search_index.hpp"
+#include "static_assets.hpp"
 #include "tags.hpp"
+#include "upload_store.hpp"
 #include "user_aspects.hpp"
 #include "user_experience.hpp"
 #include "user_experience_aspects.hpp"
@@ -27,6 +43,7 @@
 #include "user_password.hpp"
 #include "user_profile.hpp"
 #include "user_register.hpp"
+#include "view_counter.hpp"
 
 using namespace cinatra;
 using namespace ormpp;
@@ -67,6 +84,34 @@ struct test_optional {
 }
 */
 
+/**
+ * @brief 创建普通索引，索引已存在时跳过
+ * MySQL的CREATE INDEX不支持IF NOT EXISTS，先查information_schema
+ */
+void create_index(db_conn &conn, std::string_view table,
+                  std::string_view index_name, std::string_view columns) {
+  auto rows = conn->query_s<std::tuple<int64_t>>(
+      "SELECT COUNT(*) FROM information_schema.statistics WHERE "
+      "table_schema = DATABASE() AND table_name = ? AND index_name = ?",
+      std::string(table), std::string(index_name));
+  if (!rows.empty() && std::get<0>(rows.front()) > 0) {
+    return;
+  }
+
+  std::string sql = "CREATE INDEX `";
+  sql.append(index_name)
+      .append("` ON `")
+      .append(table)
+      .append("` (")
+      .append(columns)
+      .append(")");
+  if (conn->execute(sql)) {
+    CINATRA_LOG_INFO << "Index '" << index_name << "' created successfully.";
+  } else {
+    CINATRA_LOG_ERROR << "Index '" << index_name << "' create error.";
+  }
+}
+
 // database
 bool init_db() {
   std::ifstream file("cfg/db_config.json", std::ios::in);
@@ -90,6 +135,9 @@ bool init_db() {
     return false;
   }
 
+  // 数据库操作在独立线程池中执行，线程数与连接数保持一致
+  db_executor::instance().init(conf.db_conn_num);
+
   auto conn = pool.get();
   conn->create_datatable<users_t>(
       ormpp_key{"id"}, ormpp_unique{{"user_name"}}, ormpp_unique{{"email"}},
@@ -105,8 +153,27 @@ bool init_db() {
   conn->create_datatable<articles_t>(ormpp_auto_key{"article_id"},
                                      ormpp_unique{{"slug"}});
 
+  // 创建文章标签关系表，两个联合索引分别用于按标签查文章和按文章查标签
+  bool created = conn->create_datatable<article_tags_t>(
+      ormpp_unique{{"tag_id", "article_id"}},
+      ormpp_unique{{"article_id", "tag_id"}},
+      ormpp_not_null{{"article_id", "tag_id"}});
+  if (created) {
+    CINATRA_LOG_INFO << "Table 'article_tags' created successfully.";
+  } else {
+    CINATRA_LOG_ERROR << "Table 'article_tags' create error.";
+  }
+  // 从articles.tag_ids回填标签关系，只在表为空时执行
+  backfill_article_tags(conn);
+
+  // 加载标签到内存
+  tag_registry::instance().load(conn);
+
+  // 建立文章全文索引
+  search_index::instance().load(conn);
+
   // 创建密码重置token表
-  bool created = conn->create_datatable<users_token_t>(
+  created = conn->create_datatable<users_token_t>(
       ormpp_auto_key{"id"}, ormpp_unique{{"user_id", "token_type"}},
       ormpp_unique{{"token"}},
       ormpp_not_null{
@@ -160,6 +227,16 @@ bool init_db() {
     CINATRA_LOG_ERROR << "Table 'user_gifts' create error.";
   }
 
+  // 列表按(created_at, id)键集分页用到的联合索引
+  create_index(conn, "articles", "idx_articles_status_created",
+               "status, is_deleted, created_at, article_id");
+  create_index(conn, "articles", "idx_articles_author_created",
+               "author_id, is_deleted, created_at, article_id");
+  create_index(conn, "article_comments", "idx_comments_user_created",
+               "user_id, comment_status, created_at, comment_id");
+  create_index(conn, "user_experience_detail", "idx_experience_user_created",
+               "user_id, created_at, id");
+
   return true;
 }
 
@@ -179,7 +256,24 @@ struct question_resp {
   std::string_view question;
 };
 
+/**
+ * @brief 在所有线程中屏蔽SIGINT和SIGTERM，必须在创建任何线程之前调用，
+ * 之后创建的线程都继承该屏蔽字，信号只由调用sigwait的线程接收
+ */
+sigset_t block_shutdown_signals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  return signals;
+}
+
 int main() {
+  // 收到SIGINT/SIGTERM时停止服务，sync_start返回后执行下面的收尾：
+  // 写回浏览量、处理完排队的经验值奖励等
+  sigset_t shutdown_signals = block_shutdown_signals();
+
   std::shared_ptr<int> log_flush_guard(nullptr, [](auto) { easylog::flush(); });
   easylog::init_log(easylog::Severity::INFO, "purecpp.log", false, false,
                     50 * 1024 * 1024, 3);
@@ -189,58 +283,68 @@ int main() {
   }
   // 从配置文件加载配置
   purecpp_config::get_instance().load_config("cfg/user_config.json");
+  auto conf = purecpp_config::get_instance().user_cfg();
 
-  // 初始化限流器
+  // 初始化限流器，并定期清理过期的限流记录
   rate_limiter::instance().init_from_config();
+  rate_limiter::instance().start_sweeper(
+      conf->rate_limit_sweep_interval_seconds);
+
+  // 初始化文章详情缓存
+  article_cache::instance().init(size_t(conf->article_cache_max_mb) * 1024 *
+                                 1024);
+
+  // 初始化列表总数缓存
+  count_cache::instance().init(conf->count_cache_ttl_seconds);
+
+  // 启动浏览量定期写回
+  view_counter::instance().start(conf->views_flush_interval_seconds);
+
+  // 启动经验值奖励的后台写入
+  experience_reward_queue::instance().start();
+
+  // 加载已退出登录的令牌
+  token_blacklist::instance().load(conf->token_blacklist_file);
+  token_blacklist::instance().start_sweeper(
+      conf->token_blacklist_sweep_interval_seconds);
+
+  // 启动上传文件的写盘线程池和发送文件的读线程池
+  file_sink::instance().init(
+      static_cast<size_t>(std::max(conf->upload_io_threads, 1)),
+      static_cast<size_t>(std::max(conf->file_read_threads, 1)),
+      static_cast<size_t>(std::max(conf->upload_max_inflight_writes, 1)),
+      parse_fsync_policy(conf->upload_fsync_policy));
+
+  // 建立文章图片的摘要索引
+  upload_store::instance().load("html/uploads/articles", "/uploads/articles");
+
+  // 启动头像缩略图线程，为还没有缩略图的头像补齐缩略图
+  avatar_thumbnailer::instance().start(conf->avatar_thumbnail_threads);
+  avatar_thumbnailer::instance().backfill("html/uploads/avatars");
+
+  // 加载静态资源，用户上传的文件由/uploads/路由单独处理
+  static_asset_store::instance().load("html", {"uploads"});
+  static_asset_store::instance().start_watch(
+      conf->static_watch_interval_seconds);
+
+  // 收到SIGHUP或配置文件修改后重新加载配置和限流规则
+  purecpp_config::get_instance().start_watch(
+      conf->config_watch_interval_seconds,
+      [](const user_config &old_cfg, const user_config &new_cfg) {
+        rate_limiter::instance().init_from_config();
+        if (old_cfg.access_token_secret != new_cfg.access_token_secret) {
+          // 密钥更换后，用旧密钥签发的令牌不能再命中校验缓存
+          verified_token_cache::instance().clear();
+        }
+      });
 
   auto &db_pool = connection_pool<dbng<mysql>>::instance();
 
   coro_http_server server(std::thread::hardware_concurrency(), 443);
   server.init_ssl("purecpp.pem", "purecpp.key");
-  server.set_file_resp_format_type(file_resp_format_type::chunked);
-  server.set_static_res_dir("", "html");
   server.set_http_handler<GET, POST>(
-      "/",
-      [](coro_http_request &req,
-         coro_http_response &resp) -> async_simple::coro::Lazy<void> {
-        auto url = req.get_url();
-        std::string file_name = "html/index.html";
-        coro_io::coro_file in_file{};
-        if (!in_file.open(file_name, std::ios::in)) {
-          resp.set_status(status_type::not_found);
-          co_return;
-        }
-        std::string_view extension = get_extension(file_name);
-        std::string_view mime = get_mime_type(extension);
-        resp.add_header("Content-Type", std::string{mime});
-        resp.set_format_type(format_type::chunked);
-
-        // 开始chunked传输
-        if (!co_await resp.get_conn()->begin_chunked()) {
-          co_return;
-        }
-        std::string content;
-        cinatra::detail::resize(content, in_file.file_size());
-        while (true) {
-          auto [ec, size] =
-              co_await in_file.async_read(content.data(), content.size());
-          if (ec) {
-            resp.set_status(status_type::no_content);
-            co_await resp.get_conn()->reply();
-            co_return;
-          }
-
-          bool r = co_await resp.get_conn()->write_chunked(
-              std::string_view(content.data(), size));
-          if (!r) {
-            co_return;
-          }
-
-          if (in_file.eof()) {
-            co_await resp.get_conn()->end_chunked();
-            break;
-          }
-        }
+      "/", [](coro_http_request &req, coro_http_response &resp) {
+        serve_static_asset(req, resp, "/index.html");
       });
 
   server.set_http_handler<GET>(
@@ -308,6 +412,8 @@ int main() {
   tags tag{};
   server.set_http_handler<GET>("/api/v1/get_tags", &tags::get_tags, tag,
                                log_request_response{});
+  server.set_http_handler<POST>("/api/v1/reload_tags", &tags::reload_tags,
+                                tag, log_request_response{}, check_token{});
 
   articles article{};
   server.set_http_handler<POST>(
@@ -330,6 +436,10 @@ int main() {
   server.set_http_handler<POST>("/api/v1/upload_file", &articles::upload_file,
                                 article, log_request_response{}, check_token{},
                                 check_upload_file{});
+  // multipart上传图片，由处理函数边读边写盘，请求体是二进制数据，不记录日志
+  server.set_http_handler<POST>("/api/v1/upload_file_raw",
+                                &articles::upload_file_raw, article,
+                                check_token{});
 
   // 评论相关路由
   articles_comment comment{};
@@ -373,50 +483,47 @@ int main() {
   server.set_http_handler<POST>("/api/v1/user/upload_avatar",
                                 &user_profile_t::upload_avatar, user_profile,
                                 log_request_response{}, check_token{});
-  // 处理上传到头像不能下载的问题
+  // multipart上传头像，不经过base64和json，由处理函数边读边写盘，
+  // 请求体是二进制数据，不记录日志
+  server.set_http_handler<POST>("/api/v1/user/upload_avatar_raw",
+                                &user_profile_t::upload_avatar_raw,
+                                user_profile, check_token{});
+  // 用户上传的头像和文章图片，文件名带时间戳，内容不会变化，允许长期缓存
   server.set_http_handler<GET>(
       "/uploads/(.*)",
       [](coro_http_request &req,
          coro_http_response &resp) -> async_simple::coro::Lazy<void> {
-        auto url = req.get_url();
-        std::string file_name;
-        file_name.append("html/").append(url);
-        coro_io::coro_file in_file{};
-        if (!in_file.open(file_name, std::ios::in)) {
-          resp.set_status(status_type::not_found);
-          co_return;
+        std::string_view url = req.get_url();
+        auto query_pos = url.find('?');
+        if (query_pos != std::string_view::npos) {
+          url = url.substr(0, query_pos);
         }
-        std::string_view extension = get_extension(file_name);
-        std::string_view mime = get_mime_type(extension);
-        resp.add_header("Content-Type", std::string{mime});
-        resp.set_format_type(format_type::chunked);
-
-        // 开始chunked传输
-        if (!co_await resp.get_conn()->begin_chunked()) {
+        if (url.find("..") != std::string_view::npos) {
+          resp.set_status(status_type::not_found);
           co_return;
         }
-        std::string content;
-        cinatra::detail::resize(content, 10240);
-        while (true) {
-          auto [ec, size] =
-              co_await in_file.async_read(content.data(), content.size());
-          if (ec) {
-            resp.set_status(status_type::no_content);
-            co_await resp.get_conn()->reply();
-            co_return;
-          }
 
-          bool r = co_await resp.get_conn()->write_chunked(
-              std::string_view(content.data(), size));
-          if (!r) {
+        std::string file_name;
+        file_name.append("html").append(url);
+
+        // 头像带?size=时返回缩略图，缩略图还没有生成时先返回原图，
+        // 原图只短时间缓存，之后的请求能拿到缩略图
+        auto size_param = req.get_query_value("size");
+        if (!size_param.empty() && url.starts_with("/uploads/avatars/")) {
+          int size = 0;
+          std::from_chars(size_param.data(),
+                          size_param.data() + size_param.size(), size);
+          if (auto thumbnail =
+                  avatar_thumbnailer::instance().find(file_name, size)) {
+            file_name = std::move(*thumbnail);
+          } else if (avatar_thumbnailer::snap_size(size) > 0 &&
+                     avatar_thumbnailer::is_supported(file_name)) {
+            co_await send_file(req, resp, file_name, "public, max-age=60");
             co_return;
           }
-
-          if (in_file.eof()) {
-            co_await resp.get_conn()->end_chunked();
-            break;
-          }
         }
+        co_await send_file(req, resp, file_name,
+                           "public, max-age=31536000, immutable");
       });
 
   // 用户文章相关路由
@@ -457,5 +564,35 @@ int main() {
   // 获取统计数据路由
   server.set_http_handler<GET>("/api/v1/stats", &articles::get_stats, article,
                                log_request_response{});
+
+  // 静态资源，按注册顺序最后匹配，不影响前面的正则路由
+  server.set_http_handler<GET>(
+      "/(.*)", [](coro_http_request &req, coro_http_response &resp) {
+        serve_static_asset(req, resp, req.get_url());
+      });
+
+  // server.stop()不是异步信号安全的，不能在信号处理函数中调用，
+  // 由单独的线程用sigwait同步等待信号
+  std::thread signal_thd([&server, shutdown_signals] {
+    int sig = 0;
+    if (sigwait(&shutdown_signals, &sig) == 0) {
+      CINATRA_LOG_INFO << "received signal " << sig << ", stopping server";
+      server.stop();
+    }
+  });
+
   server.sync_start();
+  // 服务因其它原因退出时，唤醒仍在等待信号的线程
+  pthread_kill(signal_thd.native_handle(), SIGTERM);
+  signal_thd.join();
+
+  purecpp_config::get_instance().stop_watch();
+  static_asset_store::instance().stop_watch();
+  avatar_thumbnailer::instance().stop();
+  file_sink::instance().stop();
+  view_counter::instance().stop();
+  experience_reward_queue::instance().stop();
+  rate_limiter::instance().stop_sweeper();
+  token_blacklist::instance().stop_sweeper();
+  db_executor::instance().stop();
 }
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "file_sink.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 闭区间[start, end]
+struct byte_range {
+  uint64_t start;
+  uint64_t end;
+};
+
+/**
+ * @brief 解析Range请求头
+ * 只支持单个区间：bytes=a-b、bytes=a-、bytes=-n。多个区间或格式不对时
+ * 返回std::nullopt，按规范忽略Range返回整个文件。
+ * @param unsatisfiable 区间不在文件范围内时置为true
+ */
+inline std::optional<byte_range> parse_byte_range(std::string_view header,
+                                                  uint64_t file_size,
+                                                  bool &unsatisfiable) {
+  unsatisfiable = false;
+  if (!header.starts_with("bytes=")) {
+    return std::nullopt;
+  }
+  header.remove_prefix(6);
+  if (header.find(',') != std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  auto dash = header.find('-');
+  if (dash == std::string_view::npos) {
+    return std::nullopt;
+  }
+  auto first = header.substr(0, dash);
+  auto last = header.substr(dash + 1);
+  auto parse = [](std::string_view str, uint64_t &value) {
+    auto end = str.data() + str.size();
+    auto [ptr, ec] = std::from_chars(str.data(), end, value);
+    return ec == std::errc{} && ptr == end;
+  };
+
+  uint64_t start = 0;
+  uint64_t end = 0;
+  if (first.empty()) {
+    // bytes=-n，最后n个字节
+    uint64_t suffix = 0;
+    if (!parse(last, suffix)) {
+      return std::nullopt;
+    }
+    if (suffix == 0 || file_size == 0) {
+      unsatisfiable = true;
+      return std::nullopt;
+    }
+    start = suffix >= file_size ? 0 : file_size - suffix;
+    end = file_size - 1;
+  } else {
+    if (!parse(first, start)) {
+      return std::nullopt;
+    }
+    if (last.empty()) {
+      end = file_size == 0 ? 0 : file_size - 1;
+    } else if (!parse(last, end) || end < start) {
+      return std::nullopt;
+    }
+    if (start >= file_size) {
+      unsatisfiable = true;
+      return std::nullopt;
+    }
+    end = std::min(end, file_size - 1);
+  }
+  return byte_range{start, end};
+}
+
+// RFC 7231格式的时间，如"Sun, 06 Nov 1994 08:49:37 GMT"
+inline std::string format_http_date(time_t time) {
+  struct tm tm{};
+  gmtime_r(&time, &tm);
+  char buf[64];
+  size_t len = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return std::string(buf, len);
+}
+
+/**
+ * @brief 从offset开始读取size个字节，遇到文件结尾或出错时提前返回
+ * @return 读取的字节数
+ */
+inline size_t pread_full(int fd, char *buf, size_t size, uint64_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n =
+        pread(fd, buf + done, size - done, static_cast<off_t>(offset + done));
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return done;
+}
+
+/**
+ * @brief 返回磁盘上的文件，支持Range、If-Range和If-None-Match
+ * 打开和读取文件都在file_sink的读线程池上执行，慢速的磁盘不会卡住http的
+ * io线程，也不会排在上传文件的写盘和fsync后面。
+ * 文件不超过max_buffered_size时用一次pread读出请求的区间，带准确的
+ * Content-Length一次写出；服务器启用了SSL，数据要经过用户态加密，无法用
+ * sendfile直接从页缓存发送，一次大块写已经把系统调用和加密分片降到最少。
+ * 更大的区间先写出带Content-Length的响应头，再按1MB分块发送。
+ * ETag由文件大小和修改时间生成，不需要读取文件内容。
+ * @param file_name 文件路径，调用者负责校验路径不越界
+ * @param cache_control Cache-Control响应头
+ */
+inline async_simple::coro::Lazy<void>
+send_file(cinatra::coro_http_request &req, cinatra::coro_http_response &resp,
+          const std::string &file_name, std::string_view cache_control) {
+  using cinatra::status_type;
+  constexpr uint64_t max_buffered_size = 16 * 1024 * 1024;
+  constexpr size_t stream_chunk_size = 1024 * 1024;
+
+  struct stat st{};
+  int fd = co_await file_sink::instance().post_read([&file_name, &st] {
+    int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  });
+  if (fd < 0) {
+    resp.set_status(status_type::not_found);
+    co_return;
+  }
+  std::shared_ptr<void> fd_guard(nullptr, [fd](auto) { ::close(fd); });
+  uint64_t file_size = static_cast<uint64_t>(st.st_size);
+
+  char etag_buf[64];
+  int etag_len = snprintf(etag_buf, sizeof(etag_buf), "\"%llx-%llx\"",
+                          static_cast<unsigned long long>(file_size),
+                          static_cast<unsigned long long>(st.st_mtime));
+  std::string etag(etag_buf, etag_len);
+  std::string last_modified = format_http_date(st.st_mtime);
+
+  // 大区间的响应头由这里自己写出，先收集起来
+  std::vector<std::pair<std::string, std::string>> headers = {
+      {"ETag", etag},
+      {"Last-Modified", last_modified},
+      {"Cache-Control", std::string(cache_control)},
+      {"Accept-Ranges", "bytes"}};
+  auto add_headers = [&headers, &resp] {
+    for (auto &[name, value] : headers) {
+      resp.add_header(name, value);
+    }
+  };
+
+  auto if_none_match = req.get_header_value("If-None-Match");
+  if (!if_none_match.empty() &&
+      (if_none_match == "*" ||
+       if_none_match.find(etag) != std::string_view::npos)) {
+    add_headers();
+    resp.set_status(status_type::not_modified);
+    co_return;
+  }
+
+  // If-Range和当前文件不一致时忽略Range，返回整个文件
+  std::optional<byte_range> range;
+  auto range_header = req.get_header_value("Range");
+  auto if_range = req.get_header_value("If-Range");
+  if (!range_header.empty() &&
+      (if_range.empty() || if_range == etag || if_range == last_modified)) {
+    bool unsatisfiable = false;
+    range = parse_byte_range(range_header, file_size, unsatisfiable);
+    if (unsatisfiable) {
+      add_headers();
+      resp.add_header("Content-Range", "bytes */" + std::to_string(file_size));
+      resp.set_status(status_type::range_not_satisfiable);
+      co_return;
+    }
+  }
+
+  uint64_t start = range ? range->start : 0;
+  uint64_t length = range ? range->end - range->start + 1 : file_size;
+  auto status = range ? status_type::partial_content : status_type::ok;
+  if (range) {
+    headers.emplace_back("Content-Range",
+                         "bytes " + std::to_string(range->start) + "-" +
+                             std::to_string(range->end) + "/" +
+                             std::to_string(file_size));
+  }
+  std::string_view extension = cinatra::get_extension(file_name);
+  headers.emplace_back("Content-Type",
+                       std::string{cinatra::get_mime_type(extension)});
+
+  if (length <= max_buffered_size) {
+    std::string content;
+    cinatra::detail::resize(content, length);
+    size_t n = co_await file_sink::instance().post_read([&] {
+      return pread_full(fd, content.data(), length, start);
+    });
+    if (n != length) {
+      resp.set_status(status_type::internal_server_error);
+      co_return;
+    }
+    add_headers();
+    resp.set_status_and_content(status, std::move(content));
+    co_return;
+  }
+
+  // 自己写出响应头和内容，Content-Length就是区间长度
+  resp.set_delay(true);
+  auto conn = resp.get_conn();
+  std::string head = range ? "HTTP/1.1 206 Partial Content\r\n"
+                           : "HTTP/1.1 200 OK\r\n";
+  for (auto &[name, value] : headers) {
+    head.append(name).append(": ").append(value).append("\r\n");
+  }
+  head.append("Content-Length: ")
+      .append(std::to_string(length))
+      .append("\r\n\r\n");
+  if (!co_await conn->write_data(head)) {
+    co_return;
+  }
+
+  std::string content;
+  cinatra::detail::resize(content, stream_chunk_size);
+  uint64_t offset = start;
+  uint64_t end = start + length;
+  while (offset < end) {
+    size_t size = static_cast<size_t>(
+        std::min<uint64_t>(stream_chunk_size, end - offset));
+    size_t n = co_await file_sink::instance().post_read([&] {
+      return pread_full(fd, content.data(), size, offset);
+    });
+    if (n == 0) {
+      // 文件在发送过程中被截断，已经发出的Content-Length无法兑现，
+      // 只能关闭连接
+      conn->close();
+      co_return;
+    }
+    if (!co_await conn->write_data(std::string_view(content.data(), n))) {
+      co_return;
+    }
+    offset += n;
+  }
+}
+
+} // namespace purecpp
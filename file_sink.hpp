@@ -0,0 +1,410 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+#include "common.hpp"
+#include "error_info.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 文件写完后的落盘策略
+enum class fsync_policy {
+  none, // 不主动fsync，由内核决定何时写回
+  file, // 关闭前fdatasync文件内容
+  full, // 同file，重命名后再fsync所在目录，保证文件名也已落盘
+};
+
+/**
+ * @brief 解析配置中的落盘策略，"file"、"full"之外的值都视为"none"
+ */
+inline fsync_policy parse_fsync_policy(std::string_view name) {
+  if (name == "file") {
+    return fsync_policy::file;
+  }
+  if (name == "full") {
+    return fsync_policy::full;
+  }
+  return fsync_policy::none;
+}
+
+enum class sink_status {
+  ok,
+  busy,   // 正在写入的文件数已达上限
+  failed, // 打开或写入文件失败
+};
+
+struct file_sink_stats {
+  uint64_t in_flight = 0;      // 当前正在写入的文件数
+  uint64_t peak_in_flight = 0; // 正在写入的文件数的峰值
+  uint64_t completed = 0;      // 写入完成的文件数
+  uint64_t failed = 0;         // 写入失败或中途放弃的文件数
+  uint64_t rejected = 0;       // 因达到上限被拒绝的文件数
+  uint64_t bytes_written = 0;  // 写入的总字节数
+};
+
+class file_sink;
+
+/**
+ * @brief 通过file_sink写入的一个文件
+ * 持有一个写入名额，析构时归还。没有提交就析构时关闭并删除文件，
+ * 出错的上传不会留下写了一半的文件。
+ */
+class file_sink_writer {
+public:
+  file_sink_writer() = default;
+  file_sink_writer(const file_sink_writer &) = delete;
+  file_sink_writer &operator=(const file_sink_writer &) = delete;
+  ~file_sink_writer();
+
+  bool is_open() const { return fd_ >= 0; }
+
+private:
+  friend class file_sink;
+
+  int fd_ = -1;
+  std::string path_;
+  bool committed_ = false;
+  bool holding_ = false; // 是否占用了写入名额
+};
+
+/**
+ * @brief 上传文件的异步写入器
+ * 写文件、fsync、创建目录和重命名都是阻塞的系统调用，在http的io线程中
+ * 执行时，一次慢速的写盘会卡住该线程上的所有连接。这里和db_executor
+ * 一样用独立的线程池执行文件操作，协程挂起等待完成。
+ * 同时写入的文件数有上限，达到上限时立即返回sink_status::busy，由调用者
+ * 返回503，不在io线程上排队等待。
+ * send_file读取要发送的文件通过post_read在另一个独立的读线程池上执行，
+ * 上传时的写盘和fsync不会让页面下载图片排队等待。
+ */
+class file_sink {
+public:
+  file_sink(const file_sink &) = delete;
+  file_sink &operator=(const file_sink &) = delete;
+
+  static file_sink &instance() {
+    static file_sink instance;
+    return instance;
+  }
+
+  /**
+   * @brief 启动写线程池和读线程池
+   * @param thread_num 写线程数
+   * @param read_thread_num 读线程数
+   * @param max_in_flight 同时写入的文件数上限
+   * @param policy 落盘策略
+   */
+  void init(size_t thread_num, size_t read_thread_num, size_t max_in_flight,
+            fsync_policy policy) {
+    max_in_flight_.store(std::max<size_t>(max_in_flight, 1),
+                         std::memory_order_relaxed);
+    policy_.store(policy, std::memory_order_relaxed);
+
+    std::lock_guard lock(mutex_);
+    if (pool_ != nullptr) {
+      return;
+    }
+    thread_num = std::max<size_t>(thread_num, 1);
+    read_thread_num = std::max<size_t>(read_thread_num, 1);
+    pool_ = std::make_unique<coro_io::io_context_pool>(thread_num);
+    thd_ = std::thread([this] { pool_->run(); });
+    read_pool_ = std::make_unique<coro_io::io_context_pool>(read_thread_num);
+    read_thd_ = std::thread([this] { read_pool_->run(); });
+    CINATRA_LOG_INFO << "file sink started, thread num: " << thread_num
+                     << ", read thread num: " << read_thread_num
+                     << ", max in flight: " << max_in_flight;
+  }
+
+  /**
+   * @brief 停止线程池，等待已提交的文件操作执行完成
+   */
+  void stop() {
+    std::lock_guard lock(mutex_);
+    if (pool_ == nullptr) {
+      return;
+    }
+
+    pool_->stop();
+    read_pool_->stop();
+    if (thd_.joinable()) {
+      thd_.join();
+    }
+    if (read_thd_.joinable()) {
+      read_thd_.join();
+    }
+    pool_ = nullptr;
+    read_pool_ = nullptr;
+  }
+
+  /**
+   * @brief 占用一个写入名额并打开文件，所在目录不存在时创建
+   */
+  async_simple::coro::Lazy<sink_status> open(file_sink_writer &writer,
+                                             std::filesystem::path path) {
+    if (!acquire()) {
+      co_return sink_status::busy;
+    }
+    writer.holding_ = true;
+    writer.path_ = path.string();
+    writer.fd_ = co_await post([&path] {
+      std::error_code ec;
+      std::filesystem::create_directories(path.parent_path(), ec);
+      int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+      if (fd < 0) {
+        CINATRA_LOG_ERROR << "open file failed: " << path
+                          << ", errno: " << errno;
+      }
+      return fd;
+    });
+    if (writer.fd_ < 0) {
+      co_return sink_status::failed;
+    }
+    co_return sink_status::ok;
+  }
+
+  /**
+   * @brief 追加写入，data在协程恢复前必须保持有效
+   * @return 是否全部写入
+   */
+  async_simple::coro::Lazy<bool> write(file_sink_writer &writer,
+                                       std::string_view data) {
+    if (!writer.is_open()) {
+      co_return false;
+    }
+    bool ok = co_await post([fd = writer.fd_, data] {
+      size_t done = 0;
+      while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+        done += static_cast<size_t>(n);
+      }
+      return true;
+    });
+    if (ok) {
+      bytes_written_.fetch_add(data.size(), std::memory_order_relaxed);
+    }
+    co_return ok;
+  }
+
+  /**
+   * @brief 按落盘策略fsync并关闭文件，归还写入名额
+   * @return 是否成功，失败时文件在writer析构时删除
+   */
+  async_simple::coro::Lazy<bool> commit(file_sink_writer &writer) {
+    if (!writer.is_open()) {
+      co_return false;
+    }
+    bool sync = policy() != fsync_policy::none;
+    bool ok = co_await post([fd = writer.fd_, sync] {
+      bool synced = !sync || ::fdatasync(fd) == 0;
+      return ::close(fd) == 0 && synced;
+    });
+    writer.fd_ = -1;
+    if (!ok) {
+      co_return false;
+    }
+    writer.committed_ = true;
+    release(writer);
+    completed_.fetch_add(1, std::memory_order_relaxed);
+    co_return true;
+  }
+
+  /**
+   * @brief 先写入同目录的临时文件，完成后重命名为path，
+   * 读取path的请求不会读到写了一半的文件
+   */
+  async_simple::coro::Lazy<sink_status>
+  write_file(const std::filesystem::path &path, std::string_view data) {
+    auto tmp_path = path;
+    tmp_path.replace_filename("." + path.filename().string() + ".tmp");
+
+    file_sink_writer writer;
+    auto status = co_await open(writer, tmp_path);
+    if (status != sink_status::ok) {
+      co_return status;
+    }
+    if (!co_await write(writer, data) || !co_await commit(writer) ||
+        !co_await rename(tmp_path, path)) {
+      co_return sink_status::failed;
+    }
+    co_return sink_status::ok;
+  }
+
+  /**
+   * @brief 重命名文件，目标目录不存在时创建，落盘策略为full时fsync目标目录
+   */
+  async_simple::coro::Lazy<bool> rename(const std::filesystem::path &from,
+                                        const std::filesystem::path &to) {
+    bool sync_dir = policy() == fsync_policy::full;
+    bool ok = co_await post([&from, &to, sync_dir] {
+      std::error_code ec;
+      std::filesystem::create_directories(to.parent_path(), ec);
+      std::filesystem::rename(from, to, ec);
+      if (ec) {
+        CINATRA_LOG_ERROR << "rename file failed: " << ec.message();
+        std::filesystem::remove(from, ec);
+        return false;
+      }
+      if (sync_dir) {
+        int dir_fd = ::open(to.parent_path().c_str(),
+                            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+          ::fsync(dir_fd);
+          ::close(dir_fd);
+        }
+      }
+      return true;
+    });
+    co_return ok;
+  }
+
+  async_simple::coro::Lazy<void> remove(const std::filesystem::path &path) {
+    co_await post([&path] {
+      std::error_code ec;
+      std::filesystem::remove(path, ec);
+    });
+  }
+
+  /**
+   * @brief 在写线程池上执行一个阻塞的写文件操作，不占用写入名额
+   */
+  template <typename Func>
+  async_simple::coro::Lazy<std::invoke_result_t<Func>> post(Func func) {
+    auto result = co_await coro_io::post(std::move(func), get_executor());
+    co_return std::move(result).value();
+  }
+
+  /**
+   * @brief 在读线程池上执行一个阻塞的读文件操作，如打开和读取要发送的文件
+   */
+  template <typename Func>
+  async_simple::coro::Lazy<std::invoke_result_t<Func>> post_read(Func func) {
+    auto result =
+        co_await coro_io::post(std::move(func), get_read_executor());
+    co_return std::move(result).value();
+  }
+
+  fsync_policy policy() const {
+    return policy_.load(std::memory_order_relaxed);
+  }
+
+  file_sink_stats stats() const {
+    return {in_flight_.load(std::memory_order_relaxed),
+            peak_in_flight_.load(std::memory_order_relaxed),
+            completed_.load(std::memory_order_relaxed),
+            failed_.load(std::memory_order_relaxed),
+            rejected_.load(std::memory_order_relaxed),
+            bytes_written_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  friend class file_sink_writer;
+
+  file_sink() = default;
+  ~file_sink() { stop(); }
+
+  coro_io::ExecutorWrapper<> *get_executor() {
+    if (pool_ == nullptr) {
+      // 没有显式初始化时按默认配置启动
+      init(2, 2, max_in_flight_.load(std::memory_order_relaxed), policy());
+    }
+    return pool_->get_executor();
+  }
+
+  coro_io::ExecutorWrapper<> *get_read_executor() {
+    if (read_pool_ == nullptr) {
+      init(2, 2, max_in_flight_.load(std::memory_order_relaxed), policy());
+    }
+    return read_pool_->get_executor();
+  }
+
+  bool acquire() {
+    uint64_t max_in_flight = max_in_flight_.load(std::memory_order_relaxed);
+    uint64_t current = in_flight_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (current > max_in_flight) {
+      in_flight_.fetch_sub(1, std::memory_order_relaxed);
+      uint64_t rejected = rejected_.fetch_add(1, std::memory_order_relaxed);
+      CINATRA_LOG_WARNING << "file sink busy, in flight: " << current - 1
+                          << "/" << max_in_flight
+                          << ", rejected: " << rejected + 1;
+      return false;
+    }
+    uint64_t peak = peak_in_flight_.load(std::memory_order_relaxed);
+    while (current > peak && !peak_in_flight_.compare_exchange_weak(
+                                 peak, current, std::memory_order_relaxed)) {
+    }
+    return true;
+  }
+
+  void release(file_sink_writer &writer) {
+    if (writer.holding_) {
+      writer.holding_ = false;
+      in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  std::unique_ptr<coro_io::io_context_pool> pool_; // 写线程池
+  std::thread thd_;
+  std::unique_ptr<coro_io::io_context_pool> read_pool_; // 读线程池
+  std::thread read_thd_;
+  std::mutex mutex_;
+
+  std::atomic<uint64_t> max_in_flight_{64};
+  std::atomic<fsync_policy> policy_{fsync_policy::none};
+
+  std::atomic<uint64_t> in_flight_{0};
+  std::atomic<uint64_t> peak_in_flight_{0};
+  std::atomic<uint64_t> completed_{0};
+  std::atomic<uint64_t> failed_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+};
+
+inline file_sink_writer::~file_sink_writer() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  if (!committed_ && !path_.empty()) {
+    // 出错或客户端中途断开，删除写了一半的文件
+    ::unlink(path_.c_str());
+    file_sink::instance().failed_.fetch_add(1, std::memory_order_relaxed);
+  }
+  file_sink::instance().release(*this);
+}
+
+/**
+ * @brief 根据file_sink返回的状态设置错误响应
+ */
+inline void set_file_sink_error(coro_http_response &resp, sink_status status) {
+  if (status == sink_status::busy) {
+    resp.add_header("Retry-After", "1");
+    resp.set_status_and_content(status_type::service_unavailable,
+                                make_error(PURECPP_ERROR_UPLOAD_BUSY));
+    return;
+  }
+  resp.set_status_and_content(status_type::internal_server_error,
+                              make_error("保存文件失败"));
+}
+
+} // namespace purecpp
@@ -184,6 +184,10 @@ class APIService {
             'Content-Type': 'application/json',
             ...options.headers
         };
+        // FormData的Content-Type由浏览器加上boundary后设置
+        if (options.body instanceof FormData) {
+            delete headers['Content-Type'];
+        }
 
         // 检查token是否即将过期
         if (this.isAccessTokenExpiring()) {
@@ -501,33 +505,32 @@ class APIService {
         return response;
     }
 
-    // 上传用户头像
-    async uploadAvatar(userId, file) {
-        // 将图片转换为base64格式的辅助方法
-        const fileToBase64 = (file) => {
-            return new Promise((resolve, reject) => {
-                const reader = new FileReader();
-                reader.onload = () => resolve(reader.result.split(',')[1]);
-                reader.onerror = error => reject(error);
-                reader.readAsDataURL(file);
-            });
-        };
+    // 图片用FormData上传，不再转换成base64
+    isRawUploadImage(file) {
+        return /\.(jpe?g|png|gif)$/i.test(file.name);
+    }
 
-        try {
-            // 将图片转换为base64格式
-            const base64Data = await fileToBase64(file);
+    uploadRaw(endpoint, file) {
+        const formData = new FormData();
+        formData.append('file', file);
+        return this.request(`${endpoint}?filename=${encodeURIComponent(file.name)}`, {
+            method: 'POST',
+            body: formData
+        });
+    }
 
-            // 构建JSON请求
-            const uploadData = {
-                user_id: userId,
-                avatar_data: base64Data,
-                filename: file.name
-            };
+    // 头像缩略图地址，size为显示尺寸（像素），服务端取不小于它的缩略图
+    avatarUrl(url, size) {
+        if (!url || !url.startsWith('/uploads/avatars/')) {
+            return url;
+        }
+        return `${url}?size=${Math.ceil(size * (window.devicePixelRatio || 1))}`;
+    }
 
-            const response = await this.request('/api/v1/user/upload_avatar', {
-                method: 'POST',
-                body: JSON.stringify(uploadData)
-            });
+    // 上传用户头像
+    async uploadAvatar(userId, file) {
+        try {
+            const response = await this.uploadRaw('/api/v1/user/upload_avatar_raw', file);
 
             // 如果上传成功，更新本地存储的用户头像信息
             if (response.success && response.data && response.data.url) {
@@ -545,7 +548,12 @@ class APIService {
     }
 
     async uploadFile(userId, file) {
-        // 将图片转换为base64格式的辅助方法
+        if (this.isRawUploadImage(file)) {
+            return this.uploadRaw('/api/v1/upload_file_raw', file);
+        }
+
+        // pdf、txt仍转换为base64，由服务端检查内容
+        // 将文件转换为base64格式的辅助方法
         const fileToBase64 = (file) => {
             return new Promise((resolve, reject) => {
                 const reader = new FileReader();
@@ -213,7 +213,7 @@ function checkUserLogin() {
         // 更新用户头像
         const userAvatarElement = document.getElementById('user-avatar');
         if (userAvatarElement) {
-            userAvatarElement.src = userInfo.avatar;
+            userAvatarElement.src = apiService.avatarUrl(userInfo.avatar, 24);
         }
     } else {
         // 用户未登录，显示登录/注册链接，隐藏用户信息图标
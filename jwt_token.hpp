@@ -1,13 +1,29 @@
 #pragma once
 #include "config.hpp"
+#include "file_sink.hpp"
+#include "request_context.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cinatra.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <mutex>
+#include <openssl/core_names.h>
 #include <openssl/evp.h>
-#include <openssl/hmac.h>
+#include <openssl/params.h>
+#include <openssl/sha.h>
 #include <optional>
+#include <shared_mutex>
 #include <string>
-#include <unordered_set>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace purecpp {
 
@@ -43,14 +59,109 @@ struct refresh_token_info {
   uint64_t exp; // 过期时间
 };
 
+/**
+ * @brief 每个线程复用的HMAC上下文
+ * 每个密钥保存一个已经设置好密钥的EVP_MAC_CTX，签名时复制一份再计算，
+ * 省去每次签名时重新处理密钥。access和refresh两个密钥各占一个槽位。
+ */
+class hmac_context {
+public:
+  hmac_context() = default;
+  hmac_context(const hmac_context &) = delete;
+  hmac_context &operator=(const hmac_context &) = delete;
+
+  ~hmac_context() {
+    for (auto &slot : slots_) {
+      EVP_MAC_CTX_free(slot.ctx);
+    }
+    EVP_MAC_free(mac_);
+  }
+
+  static hmac_context &local() {
+    thread_local hmac_context context;
+    return context;
+  }
+
+  /**
+   * @brief 计算HMAC-SHA1
+   * @param hash 长度至少为EVP_MAX_MD_SIZE
+   * @return 是否成功，成功时签名写入hash，长度写入hash_len
+   */
+  bool sign(std::string_view data, const std::string &key,
+            unsigned char *hash, size_t &hash_len) {
+    EVP_MAC_CTX *keyed = get_keyed_ctx(key);
+    if (keyed == nullptr) {
+      return false;
+    }
+
+    EVP_MAC_CTX *ctx = EVP_MAC_CTX_dup(keyed);
+    if (ctx == nullptr) {
+      return false;
+    }
+    auto input = reinterpret_cast<const unsigned char *>(data.data());
+    bool ok = EVP_MAC_update(ctx, input, data.size()) &&
+              EVP_MAC_final(ctx, hash, &hash_len, EVP_MAX_MD_SIZE);
+    EVP_MAC_CTX_free(ctx);
+    return ok;
+  }
+
+private:
+  struct slot_t {
+    std::string key;
+    EVP_MAC_CTX *ctx = nullptr;
+  };
+
+  EVP_MAC_CTX *get_keyed_ctx(const std::string &key) {
+    for (auto &slot : slots_) {
+      if (slot.ctx != nullptr && slot.key == key) {
+        return slot.ctx;
+      }
+    }
+
+    if (mac_ == nullptr) {
+      mac_ = EVP_MAC_fetch(nullptr, OSSL_MAC_NAME_HMAC, nullptr);
+      if (mac_ == nullptr) {
+        return nullptr;
+      }
+    }
+
+    // 没有命中时轮流替换槽位，密钥修改后旧的上下文会被覆盖
+    auto &slot = slots_[next_slot_];
+    next_slot_ = (next_slot_ + 1) % slots_.size();
+    EVP_MAC_CTX_free(slot.ctx);
+    slot.ctx = EVP_MAC_CTX_new(mac_);
+    if (slot.ctx == nullptr) {
+      return nullptr;
+    }
+
+    char digest[] = "SHA1";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()};
+    if (!EVP_MAC_init(slot.ctx,
+                      reinterpret_cast<const unsigned char *>(key.data()),
+                      key.size(), params)) {
+      EVP_MAC_CTX_free(slot.ctx);
+      slot.ctx = nullptr;
+      return nullptr;
+    }
+    slot.key = key;
+    return slot.ctx;
+  }
+
+  EVP_MAC *mac_ = nullptr;
+  std::array<slot_t, 2> slots_;
+  size_t next_slot_ = 0;
+};
+
 // HMAC-SHA1签名，直接返回二进制数据
-std::string hmac_sha1(const std::string &data, const std::string &key) {
+inline std::string hmac_sha1(std::string_view data, const std::string &key) {
   unsigned char hash[EVP_MAX_MD_SIZE];
-  unsigned int hash_len = 0;
+  size_t hash_len = 0;
 
-  HMAC(EVP_sha1(), key.c_str(), key.size(),
-       reinterpret_cast<const unsigned char *>(data.c_str()), data.size(), hash,
-       &hash_len);
+  if (!hmac_context::local().sign(data, key, hash, hash_len)) {
+    return {};
+  }
 
   // 直接返回二进制哈希值，无需转换为十六进制
   return std::string(reinterpret_cast<const char *>(hash), hash_len);
@@ -58,13 +169,13 @@ std::string hmac_sha1(const std::string &data, const std::string &key) {
 
 // 生成简化JWT token的函数（无Header部分，仅包含Payload和Signature）
 std::string generate_access_token(uint64_t user_id) {
-  auto &conf = purecpp_config::get_instance().user_cfg_;
+  auto conf = purecpp_config::get_instance().user_cfg();
 
   // 构建Payload，使用秒级时间戳
   uint64_t now = get_timestamp_seconds();
   // 从配置文件中获取过期时间（分钟），转换为秒
   uint64_t exp =
-      now + static_cast<uint64_t>(conf.access_token_exp_minutes) * 60;
+      now + static_cast<uint64_t>(conf->access_token_exp_minutes) * 60;
 
   // 构建Payload JSON字符串，仅包含必要字段
   access_token_info t_token_info{user_id, now, exp};
@@ -74,7 +185,7 @@ std::string generate_access_token(uint64_t user_id) {
   std::string encoded_payload = cinatra::base64_encode(payload);
 
   // 构建Signature（仅对Payload进行签名，无Header），使用HMAC-SHA1
-  std::string signature = hmac_sha1(encoded_payload, conf.access_token_secret);
+  std::string signature = hmac_sha1(encoded_payload, conf->access_token_secret);
   std::string encoded_signature = cinatra::base64_encode(signature);
 
   // 构建简化的JWT（仅包含Payload和Signature，用点分隔）
@@ -83,13 +194,13 @@ std::string generate_access_token(uint64_t user_id) {
 
 // 生成refresh token的函数
 std::string generate_refresh_token(uint64_t user_id) {
-  auto &conf = purecpp_config::get_instance().user_cfg_;
+  auto conf = purecpp_config::get_instance().user_cfg();
 
   // 构建Payload，使用秒级时间戳
   uint64_t now = get_timestamp_seconds();
   // 从配置文件中获取过期时间（天），转换为秒
   uint64_t exp =
-      now + static_cast<uint64_t>(conf.refresh_token_exp_days) * 24 * 60 * 60;
+      now + static_cast<uint64_t>(conf->refresh_token_exp_days) * 24 * 60 * 60;
 
   // 构建Payload JSON字符串，仅包含必要字段
   refresh_token_info t_refresh_token_info{user_id, now, exp};
@@ -99,7 +210,8 @@ std::string generate_refresh_token(uint64_t user_id) {
   std::string encoded_payload = cinatra::base64_encode(payload);
 
   // 构建Signature（仅对Payload进行签名，无Header），使用HMAC-SHA1
-  std::string signature = hmac_sha1(encoded_payload, conf.refresh_token_secret);
+  std::string signature =
+      hmac_sha1(encoded_payload, conf->refresh_token_secret);
   std::string encoded_signature = cinatra::base64_encode(signature);
 
   // 构建refresh token（仅包含Payload和Signature，用点分隔）
@@ -115,14 +227,14 @@ token_response generate_jwt_token(uint64_t user_id, const std::string &username,
 
   // 计算过期时间，使用秒级时间戳
   uint64_t now = get_timestamp_seconds();
-  auto &conf = purecpp_config::get_instance().user_cfg_;
+  auto conf = purecpp_config::get_instance().user_cfg();
 
   uint64_t access_token_expires_at =
-      now + static_cast<uint64_t>(conf.access_token_exp_minutes) * 60;
+      now + static_cast<uint64_t>(conf->access_token_exp_minutes) * 60;
   uint64_t refresh_token_expires_at =
-      now + static_cast<uint64_t>(conf.refresh_token_exp_days) * 24 * 60 * 60;
+      now + static_cast<uint64_t>(conf->refresh_token_exp_days) * 24 * 60 * 60;
   uint64_t access_token_lifetime =
-      static_cast<uint64_t>(conf.access_token_exp_minutes) * 60;
+      static_cast<uint64_t>(conf->access_token_exp_minutes) * 60;
 
   // 构建token响应
   token_response response;
@@ -135,7 +247,110 @@ token_response generate_jwt_token(uint64_t user_id, const std::string &username,
   return response;
 }
 
-// 令牌黑名单类
+// token的SHA-256摘要的前16字节，作为校验缓存和黑名单的键
+using token_digest = std::array<unsigned char, 16>;
+
+inline token_digest make_token_digest(std::string_view token) {
+  unsigned char hash[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char *>(token.data()), token.size(),
+         hash);
+  token_digest digest;
+  std::memcpy(digest.data(), hash, digest.size());
+  return digest;
+}
+
+struct token_digest_hash {
+  size_t operator()(const token_digest &digest) const {
+    size_t hash = 0;
+    std::memcpy(&hash, digest.data(), sizeof(hash));
+    return hash;
+  }
+};
+
+/**
+ * @brief 已验证的access token缓存
+ * 同一个access token在有效期内会被反复使用，验证通过后按token的摘要缓存
+ * 解析出的信息，之后的请求只需要一次SHA-256和哈希查找，不再做base64解码、
+ * HMAC和json解析。键是定长的摘要，不保存完整的token。
+ * 按摘要分片，查找只加共享锁；每个分片条目数有上限，过期的条目在插入时
+ * 清理，加入黑名单的token会立即从缓存中删除。
+ */
+class verified_token_cache {
+public:
+  verified_token_cache(const verified_token_cache &) = delete;
+  verified_token_cache &operator=(const verified_token_cache &) = delete;
+
+  static verified_token_cache &instance() {
+    static verified_token_cache instance;
+    return instance;
+  }
+
+  std::optional<access_token_info> get(const token_digest &digest,
+                                       uint64_t now) {
+    auto &shard = get_shard(digest);
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.tokens.find(digest);
+    if (it == shard.tokens.end() || now > it->second.exp) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  void put(const token_digest &digest, const access_token_info &info,
+           uint64_t now) {
+    auto &shard = get_shard(digest);
+    std::unique_lock lock(shard.mutex);
+    if (shard.tokens.size() >= max_entries_per_shard) {
+      std::erase_if(shard.tokens,
+                    [now](const auto &item) { return now > item.second.exp; });
+    }
+    if (shard.tokens.size() >= max_entries_per_shard) {
+      // 仍然没有空间时随便淘汰一个，被淘汰的token下次重新验证即可
+      shard.tokens.erase(shard.tokens.begin());
+    }
+    shard.tokens.insert_or_assign(digest, info);
+  }
+
+  void erase(const token_digest &digest) {
+    auto &shard = get_shard(digest);
+    std::unique_lock lock(shard.mutex);
+    shard.tokens.erase(digest);
+  }
+
+  void clear() {
+    for (auto &shard : shards_) {
+      std::unique_lock lock(shard.mutex);
+      shard.tokens.clear();
+    }
+  }
+
+private:
+  verified_token_cache() = default;
+
+  static constexpr size_t shard_num = 16;
+  static constexpr size_t max_entries_per_shard = 4096;
+
+  struct shard_t {
+    std::shared_mutex mutex;
+    std::unordered_map<token_digest, access_token_info, token_digest_hash>
+        tokens;
+  };
+
+  shard_t &get_shard(const token_digest &digest) {
+    return shards_[digest.back() % shard_num];
+  }
+
+  std::array<shard_t, shard_num> shards_;
+};
+
+/**
+ * @brief 令牌黑名单
+ * 按token的SHA-256摘要(前16字节)分片保存token的过期时间。token过期后本身
+ * 已经无法通过校验，后台线程定期清理过期的条目，黑名单不会无限增长，
+ * 全部过期后重新回到为空的状态。
+ * 查询只加分片的共享锁，黑名单为空时不做任何计算；
+ * 新增条目在file_sink的线程池上追加写入本地文件，重启后通过load重新加载。
+ */
 class token_blacklist {
 public:
   // 获取单例实例
@@ -144,29 +359,272 @@ public:
     return instance;
   }
 
-  // 添加令牌到黑名单
-  void add(const std::string &token) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    blacklist_.insert(token);
+  /**
+   * @brief 从文件加载黑名单，去掉已过期的条目后重写文件
+   * @param path 黑名单文件路径，之后新增的条目也追加到这个文件
+   */
+  void load(const std::string &path) {
+    std::error_code ec;
+    auto parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) {
+      std::filesystem::create_directories(parent, ec);
+    }
+
+    uint64_t now = get_timestamp_seconds();
+    std::vector<std::pair<digest_t, uint64_t>> entries;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+      auto entry = parse_line(line);
+      if (entry.has_value() && entry->second >= now) {
+        entries.push_back(*entry);
+      }
+    }
+    in.close();
+
+    for (auto &[digest, exp] : entries) {
+      insert(digest, exp);
+    }
+
+    std::lock_guard lock(file_mutex_);
+    path_ = path;
+    // 先写临时文件再替换，避免写到一半时丢失原有的黑名单
+    std::string tmp_path = path + ".tmp";
+    {
+      std::ofstream out(tmp_path, std::ios::trunc);
+      for (auto &[digest, exp] : entries) {
+        out << format_line(digest, exp);
+      }
+    }
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+      CINATRA_LOG_ERROR << "rewrite token blacklist failed: " << ec.message();
+    }
+    CINATRA_LOG_INFO << "token blacklist loaded, tokens: " << entries.size();
+  }
+
+  /**
+   * @brief 启动定期清理过期条目的后台线程
+   * @param interval_seconds 清理间隔（秒）
+   */
+  void start_sweeper(int interval_seconds) {
+    std::lock_guard lock(thd_mutex_);
+    if (thd_.joinable()) {
+      return;
+    }
+
+    stop_ = false;
+    interval_ = std::chrono::seconds(std::max(interval_seconds, 1));
+    thd_ = std::thread([this] {
+      std::unique_lock lock(thd_mutex_);
+      while (!stop_) {
+        cv_.wait_for(lock, interval_, [this] { return stop_; });
+        if (stop_) {
+          break;
+        }
+        lock.unlock();
+        sweep(get_timestamp_seconds());
+        lock.lock();
+      }
+    });
+  }
+
+  void stop_sweeper() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (!thd_.joinable()) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thd_.join();
+  }
+
+  // 添加令牌到黑名单，过期时间从token中解析
+  async_simple::coro::Lazy<void> add(const std::string &token) {
+    co_await add(token, token_exp(token));
+  }
+
+  /**
+   * @brief 添加令牌到黑名单，立即生效，写文件完成后恢复协程
+   * @param exp 令牌过期时间（秒），过期后条目会被清理
+   */
+  async_simple::coro::Lazy<void> add(const std::string &token, uint64_t exp) {
+    auto digest = make_token_digest(token);
+    insert(digest, exp);
+    verified_token_cache::instance().erase(digest);
+
+    // 追加写文件是阻塞的，不在http的io线程上执行
+    auto line = format_line(digest, exp);
+    co_await file_sink::instance().post([this, &line] { append(line); });
   }
 
   // 检查令牌是否在黑名单中
   bool contains(const std::string &token) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return blacklist_.find(token) != blacklist_.end();
+    if (count_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
+    return contains(make_token_digest(token));
+  }
+
+  bool contains(const token_digest &digest) {
+    if (count_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
+
+    auto &shard = get_shard(digest);
+    std::shared_lock lock(shard.mutex);
+    return shard.entries.find(digest) != shard.entries.end();
   }
 
+  size_t size() const { return count_.load(std::memory_order_relaxed); }
+
 private:
   // 私有构造函数
   token_blacklist() = default;
+  ~token_blacklist() { stop_sweeper(); }
   // 禁用拷贝和赋值
   token_blacklist(const token_blacklist &) = delete;
   token_blacklist &operator=(const token_blacklist &) = delete;
 
-  // 令牌黑名单
-  std::unordered_set<std::string> blacklist_;
-  // 互斥锁保护并发访问
-  std::mutex mutex_;
+  static constexpr size_t shard_num = 16;
+
+  using digest_t = token_digest;
+
+  struct shard_t {
+    std::shared_mutex mutex;
+    // 摘要->exp
+    std::unordered_map<digest_t, uint64_t, token_digest_hash> entries;
+  };
+
+  shard_t &get_shard(const digest_t &digest) {
+    return shards_[digest.back() % shard_num];
+  }
+
+  void insert(const digest_t &digest, uint64_t exp) {
+    auto &shard = get_shard(digest);
+    std::unique_lock lock(shard.mutex);
+    auto [it, inserted] = shard.entries.try_emplace(digest, exp);
+    if (inserted) {
+      count_.fetch_add(1, std::memory_order_release);
+    } else {
+      it->second = std::max(it->second, exp);
+    }
+  }
+
+  /**
+   * @brief 删除所有已过期的条目
+   */
+  void sweep(uint64_t now) {
+    if (count_.load(std::memory_order_acquire) == 0) {
+      return;
+    }
+
+    size_t removed = 0;
+    for (auto &shard : shards_) {
+      std::unique_lock lock(shard.mutex);
+      removed += std::erase_if(
+          shard.entries, [now](const auto &item) { return item.second < now; });
+    }
+    if (removed > 0) {
+      count_.fetch_sub(removed, std::memory_order_release);
+      CINATRA_LOG_INFO << "token blacklist sweep, removed: " << removed
+                       << ", tokens: " << size();
+    }
+  }
+
+  void append(const std::string &line) {
+    std::lock_guard lock(file_mutex_);
+    if (path_.empty()) {
+      return;
+    }
+    std::ofstream out(path_, std::ios::app);
+    out << line;
+    if (!out) {
+      CINATRA_LOG_ERROR << "append token blacklist failed: " << path_;
+    }
+  }
+
+  /**
+   * @brief 从token的Payload中解析过期时间，不校验签名
+   * 解析失败时按refresh token的最长有效期保守处理
+   */
+  static uint64_t token_exp(const std::string &token) {
+    auto payload = cinatra::base64_decode(token.substr(0, token.find('.')));
+    if (payload.has_value()) {
+      refresh_token_info info{};
+      std::error_code ec;
+      iguana::from_json(info, *payload, ec);
+      if (!ec && info.exp > 0) {
+        return info.exp;
+      }
+    }
+
+    auto conf = purecpp_config::get_instance().user_cfg();
+    return get_timestamp_seconds() +
+           static_cast<uint64_t>(conf->refresh_token_exp_days) * 24 * 60 * 60;
+  }
+
+  // 文件中每行一条："32位十六进制摘要 过期时间"
+  static std::string format_line(const digest_t &digest, uint64_t exp) {
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string line;
+    for (unsigned char c : digest) {
+      line.push_back(hex[c >> 4]);
+      line.push_back(hex[c & 0x0F]);
+    }
+    line.append(" ").append(std::to_string(exp)).append("\n");
+    return line;
+  }
+
+  static std::optional<std::pair<digest_t, uint64_t>>
+  parse_line(std::string_view line) {
+    if (line.size() < 34 || line[32] != ' ') {
+      return std::nullopt;
+    }
+
+    auto from_hex = [](char c) -> int {
+      if (c >= '0' && c <= '9') {
+        return c - '0';
+      }
+      if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+      }
+      return -1;
+    };
+
+    digest_t digest;
+    for (size_t i = 0; i < digest.size(); ++i) {
+      int high = from_hex(line[i * 2]);
+      int low = from_hex(line[i * 2 + 1]);
+      if (high < 0 || low < 0) {
+        return std::nullopt;
+      }
+      digest[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+
+    uint64_t exp = 0;
+    auto exp_str = line.substr(33);
+    auto [ptr, ec] =
+        std::from_chars(exp_str.data(), exp_str.data() + exp_str.size(), exp);
+    if (ec != std::errc{}) {
+      return std::nullopt;
+    }
+    return std::make_pair(digest, exp);
+  }
+
+  std::array<shard_t, shard_num> shards_;
+  std::atomic<size_t> count_{0};
+
+  std::mutex file_mutex_;
+  std::string path_;
+
+  std::thread thd_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  std::chrono::seconds interval_{60};
+  bool stop_ = false;
 };
 
 // 验证refresh token
@@ -200,10 +658,9 @@ validate_refresh_token(const std::string &token) {
   std::string decoded_signature = *decoded_signature_opt;
 
   // 验证Signature，使用HMAC-SHA1
-  const std::string &refresh_token_secret =
-      purecpp_config::get_instance().user_cfg_.refresh_token_secret;
+  auto conf = purecpp_config::get_instance().user_cfg();
   std::string expected_signature =
-      hmac_sha1(encoded_payload, refresh_token_secret);
+      hmac_sha1(encoded_payload, conf->refresh_token_secret);
 
   if (decoded_signature != expected_signature) {
     return {TokenValidationResult::InvalidSignature, std::nullopt};
@@ -252,17 +709,11 @@ token_response refresh_access_token(const std::string &refresh_token,
                      std::chrono::system_clock::now().time_since_epoch())
                      .count();
 
-  uint64_t access_token_expires_at =
-      now +
-      static_cast<uint64_t>(
-          purecpp_config::get_instance().user_cfg_.access_token_exp_minutes) *
-          60;
-
   // 计算access token有效期，单位：秒
+  auto conf = purecpp_config::get_instance().user_cfg();
   uint64_t access_token_lifetime =
-      static_cast<uint64_t>(
-          purecpp_config::get_instance().user_cfg_.access_token_exp_minutes) *
-      60;
+      static_cast<uint64_t>(conf->access_token_exp_minutes) * 60;
+  uint64_t access_token_expires_at = now + access_token_lifetime;
 
   // 构建token响应(保持refresh token有效期)
   token_response response;
@@ -278,12 +729,21 @@ token_response refresh_access_token(const std::string &refresh_token,
 // Token校验函数
 std::pair<TokenValidationResult, std::optional<access_token_info>>
 validate_jwt_token(const std::string &token) {
+  // 黑名单和校验缓存共用一次计算的摘要
+  auto digest = make_token_digest(token);
+
   // 检查令牌是否在黑名单中
-  if (token_blacklist::instance().contains(token)) {
+  if (token_blacklist::instance().contains(digest)) {
     return {TokenValidationResult::Expired,
             std::nullopt}; // 使用Expired状态表示已注销
   }
 
+  // 验证过的token直接从缓存中获取
+  uint64_t now = get_timestamp_seconds();
+  if (auto cached = verified_token_cache::instance().get(digest, now)) {
+    return {TokenValidationResult::Valid, *cached};
+  }
+
   // 分割JWT，Payload.Signature
   size_t first_dot = token.find('.');
   if (first_dot == std::string::npos) {
@@ -305,10 +765,10 @@ validate_jwt_token(const std::string &token) {
   std::string decoded_signature = *decoded_signature_opt;
 
   // 从配置文件中获取JWT密钥
-  const std::string &jwt_secret =
-      purecpp_config::get_instance().user_cfg_.access_token_secret;
+  auto conf = purecpp_config::get_instance().user_cfg();
   // 校验Signature，使用HMAC-SHA1
-  std::string expected_signature = hmac_sha1(encoded_payload, jwt_secret);
+  std::string expected_signature =
+      hmac_sha1(encoded_payload, conf->access_token_secret);
   if (decoded_signature != expected_signature) {
     return {TokenValidationResult::InvalidSignature, std::nullopt};
   }
@@ -321,13 +781,10 @@ validate_jwt_token(const std::string &token) {
     return {TokenValidationResult::InvalidFormat, std::nullopt};
   }
   // 验证token是否过期，使用秒级时间戳
-  uint64_t current_time =
-      std::chrono::duration_cast<std::chrono::seconds>(
-          std::chrono::system_clock::now().time_since_epoch())
-          .count();
-  if (current_time > info.exp) {
+  if (now > info.exp) {
     return {TokenValidationResult::Expired, std::nullopt};
   }
+  verified_token_cache::instance().put(digest, info, now);
   return {TokenValidationResult::Valid, info};
 }
 
@@ -336,17 +793,8 @@ validate_jwt_token(const std::string &token) {
  * @param req HTTP请求
  * @return 用户ID
  */
-uint64_t get_user_id_from_token(coro_http_request &req) {
-  auto aspect_data = req.params_["user_token"];
-  if (aspect_data.empty()) {
-    return 0;
-  }
-  access_token_info token_info;
-  std::error_code ec;
-  iguana::from_json(token_info, aspect_data, ec);
-  if (ec) {
-    return 0;
-  }
-  return token_info.user_id;
+inline uint64_t get_user_id_from_token(coro_http_request &req) {
+  auto auth = get_auth_context(req);
+  return auth.has_value() ? auth->user_id : 0;
 }
 } // namespace purecpp
\ No newline at end of file
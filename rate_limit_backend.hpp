@@ -0,0 +1,555 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 限流结果
+enum class rate_limit_result : int32_t {
+  ALLOWED,      // 允许
+  RATE_LIMITED, // 被限流
+  BLOCKED       // 被封禁
+};
+
+// 限流计数表的统计信息
+struct rate_limit_stats {
+  size_t tracked_keys;      // 当前记录的(客户端, 规则)数
+  uint64_t evicted_expired; // 因窗口和封禁都已结束而清理的记录数
+  uint64_t evicted_shed;    // 记录数超过上限时淘汰的最久未访问记录数
+};
+
+/**
+ * @brief 限流计数表
+ * 固定容量的开放寻址表，每个(客户端, 规则)占一个槽位，槽位的所有字段都是
+ * 原子变量，热路径上不加锁也不分配内存。
+ * 计数采用滑动窗口估算：只保存上一个窗口和当前窗口的请求数，
+ * 估算值 = 上一窗口计数 * 上一窗口仍在滑动窗口内的比例 + 当前窗口计数。
+ * 槽位数是记录上限的两倍，保证探测范围内总能找到空位；过期的槽位由后台
+ * 定期清理，记录数超过上限时淘汰最久未访问的记录。
+ * 计数表本身不持有内存，只是一段内存(表头加槽位数组)上的视图，内存可以
+ * 来自堆，也可以是多个进程共同映射的文件，由后端决定。
+ */
+class rate_limit_table {
+public:
+  /**
+   * @brief 附加到已经用format初始化过的内存上
+   */
+  explicit rate_limit_table(void *mem)
+      : header_(static_cast<header_t *>(mem)),
+        slots_(reinterpret_cast<slot_t *>(header_ + 1)),
+        max_keys_(header_->max_keys), capacity_(header_->capacity) {}
+
+  /**
+   * @brief 计算记录上限对应的存储大小（字节）
+   */
+  static size_t storage_size(size_t max_keys) {
+    return sizeof(header_t) + capacity_for(max_keys) * sizeof(slot_t);
+  }
+
+  /**
+   * @brief 在内存上初始化一个空的计数表
+   * @param mem 至少storage_size(max_keys)字节，按8字节对齐
+   */
+  static void format(void *mem, size_t max_keys) {
+    size_t capacity = capacity_for(max_keys);
+    auto header = new (mem) header_t{};
+    header->capacity = capacity;
+    header->max_keys = std::max<size_t>(max_keys, max_probe);
+    auto slots = reinterpret_cast<slot_t *>(header + 1);
+    for (size_t i = 0; i < capacity; ++i) {
+      new (slots + i) slot_t{};
+    }
+    // 最后写入magic，初始化到一半退出时下次打开会重新初始化
+    header->magic = table_magic;
+  }
+
+  /**
+   * @brief 判断内存中是否是按相同记录上限初始化的计数表
+   */
+  static bool valid(const void *mem, size_t max_keys) {
+    auto header = static_cast<const header_t *>(mem);
+    return header->magic == table_magic && header->version == table_version &&
+           header->capacity == capacity_for(max_keys) &&
+           header->max_keys == std::max<size_t>(max_keys, max_probe);
+  }
+
+  /**
+   * @brief 记录一次请求并判断是否超过限制
+   * @param key 客户端和规则组合后的哈希值，不能为0
+   * @param rule 限流规则
+   * @param now 当前毫秒时间戳
+   */
+  rate_limit_result hit(uint64_t key, const rate_limit_rule &rule,
+                        uint64_t now) {
+    slot_t *slot = find_or_claim(key, now);
+    if (slot == nullptr) {
+      // 探测范围内没有空闲槽位，放行请求
+      return rate_limit_result::ALLOWED;
+    }
+
+    uint64_t window_ms =
+        static_cast<uint64_t>(std::max(rule.window_seconds, 1)) * 1000;
+    uint64_t blocked_until =
+        slot->blocked_until.load(std::memory_order_acquire);
+    if (now < blocked_until) {
+      return rate_limit_result::BLOCKED;
+    }
+
+    uint64_t window_id = now / window_ms;
+    uint64_t elapsed = now % window_ms;
+    uint64_t max_requests =
+        static_cast<uint64_t>(std::max(rule.max_requests, 0));
+    uint64_t state = slot->window.load(std::memory_order_relaxed);
+    while (true) {
+      auto [prev, curr] = roll(state, window_id);
+      uint64_t estimate = prev * (window_ms - elapsed) / window_ms + curr;
+      if (estimate >= max_requests) {
+        break;
+      }
+
+      uint64_t next = pack(window_id, prev, std::min(curr + 1, max_count));
+      if (slot->window.compare_exchange_weak(state, next,
+                                             std::memory_order_relaxed)) {
+        slot->expire_at.store(now + window_ms * 2, std::memory_order_relaxed);
+        return rate_limit_result::ALLOWED;
+      }
+    }
+
+    // 首次触发限流，封禁两个时间窗口；并发请求中只有一个能设置成功
+    uint64_t until = now + window_ms * 2;
+    slot->expire_at.store(until, std::memory_order_relaxed);
+    if (slot->blocked_until.compare_exchange_strong(
+            blocked_until, until, std::memory_order_acq_rel)) {
+      return rate_limit_result::RATE_LIMITED;
+    }
+    return rate_limit_result::BLOCKED;
+  }
+
+  /**
+   * @brief 获取封禁截止时间，没有封禁时返回0
+   */
+  uint64_t blocked_until(uint64_t key) const {
+    size_t start = key & (capacity_ - 1);
+    for (size_t i = 0; i < max_probe; ++i) {
+      const auto &slot = slots_[(start + i) & (capacity_ - 1)];
+      if (slot.key.load(std::memory_order_acquire) == key) {
+        return slot.blocked_until.load(std::memory_order_acquire);
+      }
+    }
+    return 0;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < capacity_; ++i) {
+      reset(slots_[i]);
+      slots_[i].key.store(0, std::memory_order_release);
+    }
+    header_->tracked.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 清理窗口和封禁都已结束的记录，超过上限时再淘汰最久未访问的记录
+   * 由后台线程定期调用
+   */
+  void sweep(uint64_t now) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      auto &slot = slots_[i];
+      uint64_t key = slot.key.load(std::memory_order_acquire);
+      if (key != 0 && slot.expire_at.load(std::memory_order_relaxed) <= now &&
+          release(slot, key)) {
+        header_->evicted_expired.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    size_t tracked = header_->tracked.load(std::memory_order_relaxed);
+    if (tracked <= max_keys_) {
+      return;
+    }
+
+    // 按最后访问时间淘汰到上限的3/4，留出余量，避免每次清理都要淘汰；
+    // 正在封禁中的记录不淘汰，否则被封禁的客户端会提前解封
+    std::vector<uint64_t> expire_times;
+    expire_times.reserve(tracked);
+    for (size_t i = 0; i < capacity_; ++i) {
+      auto &slot = slots_[i];
+      if (slot.key.load(std::memory_order_acquire) != 0 &&
+          slot.blocked_until.load(std::memory_order_relaxed) <= now) {
+        expire_times.push_back(slot.expire_at.load(std::memory_order_relaxed));
+      }
+    }
+
+    size_t target = max_keys_ * 3 / 4;
+    size_t shed_count = std::min(tracked - target, expire_times.size());
+    if (shed_count == 0) {
+      return;
+    }
+    std::nth_element(expire_times.begin(),
+                     expire_times.begin() + (shed_count - 1),
+                     expire_times.end());
+    uint64_t threshold = expire_times[shed_count - 1];
+
+    size_t shed = 0;
+    for (size_t i = 0; i < capacity_ && shed < shed_count; ++i) {
+      auto &slot = slots_[i];
+      uint64_t key = slot.key.load(std::memory_order_acquire);
+      if (key != 0 &&
+          slot.expire_at.load(std::memory_order_relaxed) <= threshold &&
+          slot.blocked_until.load(std::memory_order_relaxed) <= now &&
+          release(slot, key)) {
+        ++shed;
+      }
+    }
+    header_->evicted_shed.fetch_add(shed, std::memory_order_relaxed);
+  }
+
+  rate_limit_stats stats() const {
+    return {header_->tracked.load(std::memory_order_relaxed),
+            header_->evicted_expired.load(std::memory_order_relaxed),
+            header_->evicted_shed.load(std::memory_order_relaxed)};
+  }
+
+private:
+  static constexpr size_t max_probe = 32;
+  static constexpr uint64_t max_count = 0xFFFF;
+  static constexpr uint64_t table_magic = 0x4C5250; // "PRL"
+  static constexpr uint64_t table_version = 1;
+
+  // 多个进程共享时计数全部放在映射的内存里，要求原子变量无锁
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  struct header_t {
+    uint64_t magic = 0;
+    uint64_t version = table_version;
+    uint64_t capacity = 0;
+    uint64_t max_keys = 0;
+    std::atomic<uint64_t> tracked{0};
+    std::atomic<uint64_t> evicted_expired{0};
+    std::atomic<uint64_t> evicted_shed{0};
+  };
+
+  struct slot_t {
+    std::atomic<uint64_t> key{0}; // 0表示空闲
+    // 高32位为窗口编号，中间16位为上一窗口计数，低16位为当前窗口计数
+    std::atomic<uint64_t> window{0};
+    std::atomic<uint64_t> blocked_until{0}; // 封禁截止时间（毫秒）
+    std::atomic<uint64_t> expire_at{0}; // 过了这个时间槽位可以被复用
+  };
+
+  static size_t capacity_for(size_t max_keys) {
+    return std::bit_ceil(std::max<size_t>(max_keys, max_probe) * 2);
+  }
+
+  static uint64_t pack(uint64_t window_id, uint64_t prev, uint64_t curr) {
+    return (window_id & 0xFFFFFFFF) << 32 | prev << 16 | curr;
+  }
+
+  /**
+   * @brief 把保存的计数滚动到当前窗口
+   * @return 上一窗口计数和当前窗口计数
+   */
+  static std::pair<uint64_t, uint64_t> roll(uint64_t state,
+                                            uint64_t window_id) {
+    uint64_t saved_id = state >> 32;
+    uint64_t prev = (state >> 16) & max_count;
+    uint64_t curr = state & max_count;
+    window_id &= 0xFFFFFFFF;
+    if (saved_id == window_id) {
+      return {prev, curr};
+    }
+    if (saved_id + 1 == window_id) {
+      return {curr, 0};
+    }
+    return {0, 0};
+  }
+
+  static void reset(slot_t &slot) {
+    slot.window.store(0, std::memory_order_relaxed);
+    slot.blocked_until.store(0, std::memory_order_relaxed);
+    slot.expire_at.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 释放槽位，槽位已被其它key占用时返回false
+   */
+  bool release(slot_t &slot, uint64_t key) {
+    if (!slot.key.compare_exchange_strong(key, 0, std::memory_order_acq_rel)) {
+      return false;
+    }
+    reset(slot);
+    header_->tracked.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * @brief 查找key对应的槽位，不存在时占用一个空闲或已过期的槽位
+   * 两个线程同时为同一个key占用槽位时可能各占一个，只会让计数偏少，可以接受
+   */
+  slot_t *find_or_claim(uint64_t key, uint64_t now) {
+    size_t start = key & (capacity_ - 1);
+    for (size_t i = 0; i < max_probe; ++i) {
+      auto &slot = slots_[(start + i) & (capacity_ - 1)];
+      if (slot.key.load(std::memory_order_acquire) == key) {
+        return &slot;
+      }
+    }
+
+    // 探测范围内最久未访问且没有被封禁的槽位，没有空位时淘汰它
+    slot_t *oldest = nullptr;
+    uint64_t oldest_expire_at = UINT64_MAX;
+    for (size_t i = 0; i < max_probe; ++i) {
+      auto &slot = slots_[(start + i) & (capacity_ - 1)];
+      uint64_t old_key = slot.key.load(std::memory_order_acquire);
+      if (old_key == 0) {
+        if (slot.key.compare_exchange_strong(old_key, key,
+                                             std::memory_order_acq_rel)) {
+          header_->tracked.fetch_add(1, std::memory_order_relaxed);
+          return &slot;
+        }
+      } else {
+        uint64_t expire_at = slot.expire_at.load(std::memory_order_relaxed);
+        if (expire_at <= now &&
+            slot.key.compare_exchange_strong(old_key, key,
+                                             std::memory_order_acq_rel)) {
+          reset(slot);
+          header_->evicted_expired.fetch_add(1, std::memory_order_relaxed);
+          return &slot;
+        }
+        if (expire_at < oldest_expire_at &&
+            slot.blocked_until.load(std::memory_order_relaxed) <= now) {
+          oldest = &slot;
+          oldest_expire_at = expire_at;
+        }
+      }
+
+      if (old_key == key) {
+        return &slot;
+      }
+    }
+
+    if (oldest != nullptr) {
+      uint64_t old_key = oldest->key.load(std::memory_order_acquire);
+      if (old_key != 0 &&
+          oldest->key.compare_exchange_strong(old_key, key,
+                                              std::memory_order_acq_rel)) {
+        reset(*oldest);
+        header_->evicted_shed.fetch_add(1, std::memory_order_relaxed);
+        return oldest;
+      }
+    }
+    return nullptr;
+  }
+
+  header_t *header_;
+  slot_t *slots_;
+  size_t max_keys_;
+  size_t capacity_;
+};
+
+/**
+ * @brief 限流计数存储后端
+ * rate_limiter只负责匹配规则，计数和封禁状态都保存在后端中。
+ * 默认使用进程内存；多个工作进程部署在同一台机器上时使用共享内存后端，
+ * 所有进程共用一份计数，限制对整台机器生效而不是每个进程各算各的。
+ */
+class rate_limit_backend {
+public:
+  virtual ~rate_limit_backend() = default;
+
+  /**
+   * @brief 记录一次请求并判断是否超过限制
+   * @param key 客户端和规则组合后的哈希值，不能为0
+   * @param rule 限流规则
+   * @param now 当前毫秒时间戳
+   */
+  virtual rate_limit_result hit(uint64_t key, const rate_limit_rule &rule,
+                                uint64_t now) = 0;
+
+  /**
+   * @brief 获取封禁截止时间（毫秒），没有封禁时返回0
+   */
+  virtual uint64_t blocked_until(uint64_t key) const = 0;
+
+  /**
+   * @brief 清理过期记录，由后台线程定期调用
+   */
+  virtual void sweep(uint64_t now) = 0;
+
+  virtual rate_limit_stats stats() const = 0;
+
+  virtual void clear() = 0;
+};
+
+/**
+ * @brief 基于rate_limit_table的后端，子类负责提供内存
+ */
+class table_rate_limit_backend : public rate_limit_backend {
+public:
+  rate_limit_result hit(uint64_t key, const rate_limit_rule &rule,
+                        uint64_t now) override {
+    return table_->hit(key, rule, now);
+  }
+
+  uint64_t blocked_until(uint64_t key) const override {
+    return table_->blocked_until(key);
+  }
+
+  void sweep(uint64_t now) override { table_->sweep(now); }
+
+  rate_limit_stats stats() const override { return table_->stats(); }
+
+  void clear() override { table_->clear(); }
+
+protected:
+  void attach(void *mem) { table_.emplace(mem); }
+
+private:
+  std::optional<rate_limit_table> table_;
+};
+
+/**
+ * @brief 进程内存后端，计数只在当前进程内有效
+ */
+class memory_rate_limit_backend : public table_rate_limit_backend {
+public:
+  explicit memory_rate_limit_backend(size_t max_keys)
+      : storage_(std::make_unique<uint64_t[]>(
+            rate_limit_table::storage_size(max_keys) / sizeof(uint64_t))) {
+    rate_limit_table::format(storage_.get(), max_keys);
+    attach(storage_.get());
+  }
+
+private:
+  std::unique_ptr<uint64_t[]> storage_;
+};
+
+/**
+ * @brief 共享内存后端
+ * 把计数表放在一个mmap(MAP_SHARED)映射的文件里，同一台机器上打开同一个
+ * 文件的进程共用计数。第一个进程创建并初始化文件，之后的进程直接附加；
+ * 创建和初始化期间持有文件锁，避免两个进程同时初始化。
+ * 所有进程必须使用相同的记录上限，文件大小对不上时打开失败。
+ * 文件建议放在/dev/shm这类内存文件系统上，避免内核回写到磁盘。
+ */
+class shm_rate_limit_backend : public table_rate_limit_backend {
+public:
+  shm_rate_limit_backend(const shm_rate_limit_backend &) = delete;
+  shm_rate_limit_backend &operator=(const shm_rate_limit_backend &) = delete;
+
+  ~shm_rate_limit_backend() override {
+    if (mem_ != nullptr) {
+      munmap(mem_, size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  /**
+   * @brief 打开或创建共享的计数表
+   * @param path 共享文件路径
+   * @param max_keys 记录上限
+   * @return 失败时返回nullptr
+   */
+  static std::unique_ptr<shm_rate_limit_backend> open(const std::string &path,
+                                                      size_t max_keys) {
+    std::unique_ptr<shm_rate_limit_backend> backend(
+        new shm_rate_limit_backend());
+    backend->size_ = rate_limit_table::storage_size(max_keys);
+    backend->fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (backend->fd_ < 0) {
+      log_error("open", path);
+      return nullptr;
+    }
+
+    if (flock(backend->fd_, LOCK_EX) != 0) {
+      log_error("flock", path);
+      return nullptr;
+    }
+    bool ok = backend->map(path, max_keys);
+    flock(backend->fd_, LOCK_UN);
+    if (!ok) {
+      return nullptr;
+    }
+
+    backend->attach(backend->mem_);
+    return backend;
+  }
+
+private:
+  shm_rate_limit_backend() = default;
+
+  static void log_error(const char *op, const std::string &path) {
+    CINATRA_LOG_ERROR << "rate limit shm " << op << " failed: " << path
+                      << ", error: " << std::strerror(errno);
+  }
+
+  /**
+   * @brief 映射文件，新文件或未初始化的文件在这里初始化，调用时持有文件锁
+   */
+  bool map(const std::string &path, size_t max_keys) {
+    struct stat st{};
+    if (fstat(fd_, &st) != 0) {
+      log_error("fstat", path);
+      return false;
+    }
+
+    bool created = st.st_size == 0;
+    if (created) {
+      if (ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+        log_error("ftruncate", path);
+        return false;
+      }
+    } else if (static_cast<size_t>(st.st_size) != size_) {
+      CINATRA_LOG_ERROR << "rate limit shm size mismatch: " << path
+                        << ", expected: " << size_
+                        << ", actual: " << st.st_size
+                        << ", check rate_limit_max_keys of all processes";
+      return false;
+    }
+
+    void *mem =
+        mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mem == MAP_FAILED) {
+      log_error("mmap", path);
+      return false;
+    }
+    mem_ = mem;
+
+    if (created || !rate_limit_table::valid(mem_, max_keys)) {
+      rate_limit_table::format(mem_, max_keys);
+      CINATRA_LOG_INFO << "rate limit shm created: " << path
+                       << ", size: " << size_;
+    } else {
+      CINATRA_LOG_INFO << "rate limit shm attached: " << path
+                       << ", tracked keys: "
+                       << rate_limit_table(mem_).stats().tracked_keys;
+    }
+    return true;
+  }
+
+  int fd_ = -1;
+  void *mem_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace purecpp
@@ -1,29 +1,24 @@
 #pragma once
 
 #include "config.hpp"
+#include "rate_limit_backend.hpp"
+#include "route_matcher.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <optional>
 #include <regex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 namespace purecpp {
 
-// 限流结果
-enum class rate_limit_result : int32_t {
-  ALLOWED,      // 允许
-  RATE_LIMITED, // 被限流
-  BLOCKED       // 被封禁
-};
-
-// 单个请求记录
-struct request_record {
-  std::string key;                       // 限流键（IP或邮箱）
-  std::vector<uint64_t> timestamps;      // 请求时间戳列表
-  std::optional<uint64_t> blocked_until; // 封禁截止时间（毫秒时间戳）
-};
-
 // 内部限流规则配置对象
 struct rule_config : rate_limit_rule {
   bool is_regex = false; // 是否为正则表达式（自动检测）
@@ -41,16 +36,18 @@ public:
    * @brief 初始化限流器，从配置加载规则（从user_config.json）
    */
   void init_from_config() {
-    std::lock_guard lock(mutex_);
+    auto rules = std::make_shared<rule_set>();
 
-    // 清除现有规则
-    normal_rules_.clear();
-    regex_rules_.clear();
+    auto conf = purecpp_config::get_instance().user_cfg();
+    const auto &config_rules = conf->rate_limit_rules;
 
-    const auto &rules =
-        purecpp_config::get_instance().user_cfg_.rate_limit_rules;
+    for (const auto &rule : config_rules) {
+      if (!rule.enabled) {
+        // 停用的规则不参与匹配，也不能让正则规则迫使请求走匹配缓存
+        CINATRA_LOG_INFO << "Skipped disabled rate limit rule: " << rule.path;
+        continue;
+      }
 
-    for (const auto &rule : rules) {
       rule_config config;
       config.enabled = rule.enabled;
       config.max_requests = rule.max_requests;
@@ -60,204 +57,284 @@ public:
       // 自动检测是否为正则表达式
       config.is_regex = is_regex_pattern(config.path);
 
-      if (config.is_regex && !config.path.empty()) {
-        // 编译正则表达式
+      if (config.is_regex && !config.path.empty() &&
+          rules->matcher.add(config.path, rules->rules.size())) {
+        // 编译成前缀树或通配符，匹配时不再使用std::regex
+        CINATRA_LOG_INFO << "Loaded compiled rate limit rule: " << config.path
+                         << " (max=" << config.max_requests
+                         << ", window=" << config.window_seconds << "s)";
+        rules->rules.push_back(std::move(config));
+      } else if (config.is_regex && !config.path.empty()) {
+        // 超出route_matcher支持的写法，编译正则表达式
         try {
           config.regex_pattern =
               std::regex(config.path, std::regex::ECMAScript);
-          regex_rules_.push_back(config);
           CINATRA_LOG_INFO << "Loaded regex rate limit rule: " << config.path
                            << " (max=" << config.max_requests
-                           << ", window=" << config.window_seconds
-                           << "s, enabled="
-                           << (config.enabled ? "true" : "false") << ")";
+                           << ", window=" << config.window_seconds << "s)";
+          rules->regex_rules.push_back(rules->rules.size());
+          rules->rules.push_back(std::move(config));
         } catch (const std::regex_error &e) {
           CINATRA_LOG_ERROR << "Invalid regex pattern: " << config.path
                             << ", error: " << e.what();
         }
       } else {
         // 普通字符串匹配
-        normal_rules_[config.path] = config;
         CINATRA_LOG_INFO << "Loaded rate limit rule: " << config.path
                          << " (max=" << config.max_requests
-                         << ", window=" << config.window_seconds
-                         << "s, enabled=" << (config.enabled ? "true" : "false")
-                         << ")";
+                         << ", window=" << config.window_seconds << "s)";
+        rules->normal_rules[config.path] = rules->rules.size();
+        rules->rules.push_back(std::move(config));
       }
     }
+
+    rules_.store(std::move(rules), std::memory_order_release);
+
+    // 计数后端只在第一次初始化时创建，重新加载规则时沿用已有的计数
+    if (backend_ == nullptr) {
+      backend_ = create_backend(*conf);
+    }
   }
 
   /**
-   * @brief 检查是否允许请求
-   * @param key 限流键（通常是客户端IP）
-   * @param path 请求路径
-   * @return 限流结果
+   * @brief 启动后台清理线程
+   * @param interval_seconds 清理间隔（秒）
    */
-  rate_limit_result check(const std::string &key, const std::string &path) {
-    std::lock_guard lock(mutex_);
-
-    // 先检查普通字符串规则
-    auto rule_it = normal_rules_.find(path);
-    if (rule_it != normal_rules_.end() && rule_it->second.enabled) {
-      return check_rule(key, rule_it->second);
+  void start_sweeper(int interval_seconds) {
+    std::lock_guard lock(thd_mutex_);
+    if (thd_.joinable() || backend_ == nullptr) {
+      return;
     }
 
-    // 再检查正则表达式规则
-    for (const auto &rule : regex_rules_) {
-      if (rule.enabled && std::regex_match(path, rule.regex_pattern)) {
-        return check_rule(key, rule);
+    stop_ = false;
+    interval_ = std::chrono::seconds(std::max(interval_seconds, 1));
+    thd_ = std::thread([this] {
+      std::unique_lock lock(thd_mutex_);
+      while (!stop_) {
+        cv_.wait_for(lock, interval_, [this] { return stop_; });
+        if (stop_) {
+          break;
+        }
+        lock.unlock();
+        sweep();
+        lock.lock();
+      }
+    });
+  }
+
+  void stop_sweeper() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (!thd_.joinable()) {
+        return;
       }
+      stop_ = true;
     }
-
-    return rate_limit_result::ALLOWED; // 没有配置限流规则，允许请求
+    cv_.notify_one();
+    thd_.join();
   }
 
-private:
-  /**
-   * @brief 判断路径是否为正则表达式
-   * @param path 路径字符串
-   * @return true 如果包含正则表达式元字符
-   */
-  inline bool is_regex_pattern(const std::string &path) {
-    // 检查是否包含正则表达式元字符
-    static const std::regex regex_meta(R"([\^$.*+?()\[\]{}|\\])");
-    return std::regex_search(path, regex_meta);
+  rate_limit_stats stats() const {
+    if (backend_ == nullptr) {
+      return {};
+    }
+    return backend_->stats();
   }
 
   /**
-   * @brief 检查具体规则
+   * @brief 检查是否允许请求
+   * @param key 限流键（通常是客户端IP）
+   * @param path 请求路径
+   * @return 限流结果
    */
-  rate_limit_result check_rule(const std::string &key,
-                               const rule_config &config) {
-    uint64_t now = get_timestamp_milliseconds();
-    uint64_t window_ms = static_cast<uint64_t>(config.window_seconds) * 1000;
-
-    // 获取或创建请求记录
-    auto &record = records_[key + ":" + config.path];
-    auto &timestamps = record.timestamps;
-
-    // 清理过期的时间戳
-    timestamps.erase(std::remove_if(timestamps.begin(), timestamps.end(),
-                                    [now, window_ms](uint64_t ts) {
-                                      return now - ts > window_ms;
-                                    }),
-                     timestamps.end());
-
-    // 检查是否超过限制
-    if (static_cast<int>(timestamps.size()) >= config.max_requests) {
-      // 检查是否在封禁期
-      if (!record.blocked_until.has_value()) {
-        // 首次触发限流，设置封禁时间（时间窗口的2倍）
-        record.blocked_until = now + window_ms * 2;
-        CINATRA_LOG_WARNING
-            << "Rate limit exceeded for key: " << key
-            << ", rule: " << config.path
-            << ", blocking until: " << (record.blocked_until.value() / 1000);
-        return rate_limit_result::RATE_LIMITED;
-      }
-
-      // 如果还在封禁期内
-      if (now < record.blocked_until.value()) {
-        return rate_limit_result::BLOCKED;
-      }
+  rate_limit_result check(std::string_view key, std::string_view path) {
+    auto rules = rules_.load(std::memory_order_acquire);
+    size_t index = 0;
+    const rule_config *rule = rules->match(path, index);
+    if (rule == nullptr) {
+      return rate_limit_result::ALLOWED; // 没有配置限流规则，允许请求
+    }
 
-      // 封禁期已过，重置状态
-      record.blocked_until.reset();
-      timestamps.clear();
+    if (backend_ == nullptr) {
+      return rate_limit_result::ALLOWED;
     }
 
-    // 记录请求
-    timestamps.push_back(now);
-    return rate_limit_result::ALLOWED;
+    uint64_t now = get_timestamp_milliseconds();
+    auto result = backend_->hit(make_key(key, index), *rule, now);
+    if (result == rate_limit_result::RATE_LIMITED) {
+      CINATRA_LOG_WARNING << "Rate limit exceeded for key: " << key
+                          << ", rule: " << rule->path << ", blocking until: "
+                          << (now / 1000 + rule->window_seconds * 2);
+    }
+    return result;
   }
 
-public:
   /**
    * @brief 清除所有记录（用于测试或手动重置）
    */
   void clear() {
-    std::lock_guard lock(mutex_);
-    records_.clear();
+    if (backend_ != nullptr) {
+      backend_->clear();
+    }
   }
 
   /**
    * @brief 获取重试时间（秒）
    */
-  int get_retry_after(const std::string &key, const std::string &path) {
-    std::lock_guard lock(mutex_);
-
-    // 先检查普通字符串规则
-    auto rule_it = normal_rules_.find(path);
-    if (rule_it != normal_rules_.end()) {
-      return get_retry_for_rule(key, rule_it->second);
+  int get_retry_after(std::string_view key, std::string_view path) {
+    auto rules = rules_.load(std::memory_order_acquire);
+    size_t index = 0;
+    if (backend_ == nullptr || rules->match(path, index) == nullptr) {
+      return 0;
     }
 
-    // 再检查正则表达式规则
-    for (const auto &rule : regex_rules_) {
-      if (std::regex_match(path, rule.regex_pattern)) {
-        return get_retry_for_rule(key, rule);
-      }
+    uint64_t blocked_until = backend_->blocked_until(make_key(key, index));
+    uint64_t now = get_timestamp_milliseconds();
+    if (now >= blocked_until) {
+      return 0;
     }
-
-    return 0;
+    return static_cast<int>((blocked_until - now) / 1000);
   }
 
 private:
-  /**
-   * @brief 获取剩余请求次数（针对具体规则）
-   */
-  int get_remaining_for_rule(const std::string &key,
-                             const rule_config &config) {
-    uint64_t now = get_timestamp_milliseconds();
-    uint64_t window_ms = static_cast<uint64_t>(config.window_seconds) * 1000;
+  struct string_hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view sv) const {
+      return std::hash<std::string_view>{}(sv);
+    }
+  };
+
+  // 加载后不再修改的规则集合，重新加载时整体替换
+  struct rule_set {
+    std::vector<rule_config> rules; // 下标作为规则编号参与计数表的key
+    std::unordered_map<std::string, size_t, string_hash, std::equal_to<>>
+        normal_rules;                 // 普通字符串规则 -> 规则编号
+    route_matcher matcher;           // 编译后的正则规则
+    std::vector<size_t> regex_rules; // 无法编译、仍需std::regex的规则编号
+
+    // 存在regex_rules时缓存每个路径的匹配结果，避免重复执行正则
+    static constexpr size_t max_cached_paths = 4096;
+    mutable std::shared_mutex cache_mutex;
+    mutable std::unordered_map<std::string, size_t, string_hash,
+                               std::equal_to<>>
+        match_cache;
+
+    /**
+     * @brief 查找路径匹配的已启用规则，先匹配普通字符串规则，
+     * 再按配置顺序匹配正则规则
+     */
+    const rule_config *match(std::string_view path, size_t &index) const {
+      auto it = normal_rules.find(path);
+      if (it != normal_rules.end() && rules[it->second].enabled) {
+        index = it->second;
+        return &rules[index];
+      }
 
-    auto record_it = records_.find(key + ":" + config.path);
-    if (record_it == records_.end()) {
-      return config.max_requests;
+      size_t best = regex_rules.empty() ? matcher.match(path)
+                                        : match_with_cache(path);
+      if (best == route_matcher::npos) {
+        return nullptr;
+      }
+      index = best;
+      return &rules[best];
     }
 
-    // 检查是否被封禁
-    if (record_it->second.blocked_until.has_value() &&
-        now < record_it->second.blocked_until.value()) {
-      return 0;
+  private:
+    size_t match_with_cache(std::string_view path) const {
+      {
+        std::shared_lock lock(cache_mutex);
+        auto it = match_cache.find(path);
+        if (it != match_cache.end()) {
+          return it->second;
+        }
+      }
+
+      size_t best = matcher.match(path);
+      for (size_t i : regex_rules) {
+        // 编号更小的规则在配置中更靠前，优先匹配
+        if (i >= best) {
+          break;
+        }
+        if (rules[i].enabled && std::regex_match(path.begin(), path.end(),
+                                                 rules[i].regex_pattern)) {
+          best = i;
+          break;
+        }
+      }
+
+      std::unique_lock lock(cache_mutex);
+      if (match_cache.size() >= max_cached_paths) {
+        match_cache.clear();
+      }
+      match_cache.emplace(path, best);
+      return best;
     }
+  };
 
-    // 直接使用已清理过的时间戳列表
-    auto &timestamps = record_it->second.timestamps;
-    return std::max(0,
-                    config.max_requests - static_cast<int>(timestamps.size()));
+  /**
+   * @brief 判断路径是否为正则表达式
+   * @param path 路径字符串
+   * @return true 如果包含正则表达式元字符
+   */
+  static bool is_regex_pattern(const std::string &path) {
+    // 检查是否包含正则表达式元字符
+    return path.find_first_of("^$.*+?()[]{}|\\") != std::string::npos;
   }
 
   /**
-   * @brief 获取重试时间（针对具体规则）
+   * @brief 配置了共享文件时使用共享内存后端，打开失败时退回进程内存
    */
-  int get_retry_for_rule(const std::string &key, const rule_config &config) {
-    auto record_it = records_.find(key + ":" + config.path);
-    if (record_it == records_.end()) {
-      return 0;
+  static std::unique_ptr<rate_limit_backend>
+  create_backend(const user_config &conf) {
+    auto max_keys = static_cast<size_t>(std::max(conf.rate_limit_max_keys, 1));
+    if (!conf.rate_limit_shm_path.empty()) {
+      auto backend =
+          shm_rate_limit_backend::open(conf.rate_limit_shm_path, max_keys);
+      if (backend != nullptr) {
+        return backend;
+      }
+      CINATRA_LOG_WARNING << "rate limit shm unavailable, counters are "
+                             "per process";
     }
+    return std::make_unique<memory_rate_limit_backend>(max_keys);
+  }
 
-    if (!record_it->second.blocked_until.has_value()) {
-      return 0;
-    }
-
-    uint64_t now = get_timestamp_milliseconds();
-    if (now >= record_it->second.blocked_until.value()) {
-      return 0;
+  void sweep() {
+    auto before = backend_->stats();
+    backend_->sweep(get_timestamp_milliseconds());
+    auto after = backend_->stats();
+    uint64_t expired = after.evicted_expired - before.evicted_expired;
+    uint64_t shed = after.evicted_shed - before.evicted_shed;
+    if (expired > 0 || shed > 0) {
+      CINATRA_LOG_INFO << "rate limiter sweep, tracked keys: "
+                       << after.tracked_keys << ", expired: " << expired
+                       << ", shed: " << shed
+                       << ", total expired: " << after.evicted_expired
+                       << ", total shed: " << after.evicted_shed;
     }
+  }
 
-    return static_cast<int>((record_it->second.blocked_until.value() - now) /
-                            1000);
+  static uint64_t make_key(std::string_view client, size_t rule_index) {
+    uint64_t h = std::hash<std::string_view>{}(client);
+    h ^= (rule_index + 1) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h == 0 ? 1 : h;
   }
 
-  rate_limiter() = default;
-  ~rate_limiter() = default;
+  rate_limiter() : rules_(std::make_shared<rule_set>()) {}
+  ~rate_limiter() { stop_sweeper(); }
+
+  std::atomic<std::shared_ptr<const rule_set>> rules_;
+  // 启动时创建一次，之后不再替换，热路径上直接读取
+  std::unique_ptr<rate_limit_backend> backend_;
 
-  std::unordered_map<std::string, rule_config>
-      normal_rules_;                     // 普通字符串规则映射
-  std::vector<rule_config> regex_rules_; // 正则表达式规则列表
-  std::unordered_map<std::string, request_record> records_; // 请求记录
-  std::mutex mutex_;                                        // 互斥锁
+  std::thread thd_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  std::chrono::seconds interval_{30};
+  bool stop_ = false;
 };
 
 /**
@@ -270,12 +347,11 @@ private:
  * 并进行限流检查。如果请求被限流，会设置适当的响应状态码和头信息。
  */
 inline bool check_rate_limit(coro_http_request &req, coro_http_response &resp) {
-  std::string path(req.get_url());
-  std::string method(req.get_method());
+  std::string_view path = req.get_url();
 
   // 移除查询参数，只保留路径
   auto query_pos = path.find('?');
-  if (query_pos != std::string::npos) {
+  if (query_pos != std::string_view::npos) {
     path = path.substr(0, query_pos);
   }
 
@@ -293,7 +369,8 @@ inline bool check_rate_limit(coro_http_request &req, coro_http_response &resp) {
                                            std::to_string(retry_after) +
                                            "秒后再试"));
     CINATRA_LOG_WARNING << "Rate limit RATE_LIMITED: ip=" << client_ip
-                        << ", path=" << path << ", method=" << method;
+                        << ", path=" << path
+                        << ", method=" << req.get_method();
     return false;
   }
 
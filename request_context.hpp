@@ -0,0 +1,92 @@
+#pragma once
+
+#include <any>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 已通过校验的访问令牌信息
+struct auth_context {
+  uint64_t user_id = 0;
+  uint64_t iat = 0; // 签发时间
+  uint64_t exp = 0; // 过期时间
+};
+
+/**
+ * @brief 单个请求的上下文，保存在request的user_data中
+ * check_token切面写入auth，之后的参数校验切面写入data，
+ * 处理函数直接读取，不需要再解析json。user_data拷贝时只是复制一个shared_ptr。
+ */
+struct request_context {
+  std::optional<auth_context> auth;
+  std::any data; // 参数校验切面解析出的请求参数
+  // 响应体以string_view引用的数据，响应发送完之前保持有效
+  std::shared_ptr<const void> response_owner;
+};
+
+/**
+ * @brief 获取请求上下文，没有时返回nullptr
+ */
+inline std::shared_ptr<request_context>
+find_request_context(cinatra::coro_http_request &req) {
+  auto user_data = req.get_user_data();
+  auto ctx = std::any_cast<std::shared_ptr<request_context>>(&user_data);
+  return ctx == nullptr ? nullptr : *ctx;
+}
+
+/**
+ * @brief 获取请求上下文，没有时创建一个
+ */
+inline std::shared_ptr<request_context>
+get_request_context(cinatra::coro_http_request &req) {
+  auto ctx = find_request_context(req);
+  if (ctx == nullptr) {
+    ctx = std::make_shared<request_context>();
+    req.set_user_data(ctx);
+  }
+  return ctx;
+}
+
+inline void set_auth_context(cinatra::coro_http_request &req,
+                             const auth_context &auth) {
+  get_request_context(req)->auth = auth;
+}
+
+/**
+ * @brief 获取check_token写入的令牌信息，未经过check_token时返回nullopt
+ */
+inline std::optional<auth_context>
+get_auth_context(cinatra::coro_http_request &req) {
+  auto ctx = find_request_context(req);
+  if (ctx == nullptr) {
+    return std::nullopt;
+  }
+  return ctx->auth;
+}
+
+/**
+ * @brief 保存参数校验切面解析出的请求参数
+ */
+template <typename T>
+inline void set_request_data(cinatra::coro_http_request &req, T data) {
+  get_request_context(req)->data = std::move(data);
+}
+
+/**
+ * @brief 获取参数校验切面解析出的请求参数，类型不符时抛出bad_any_cast
+ */
+template <typename T>
+inline T get_request_data(cinatra::coro_http_request &req) {
+  auto ctx = find_request_context(req);
+  if (ctx == nullptr) {
+    throw std::bad_any_cast();
+  }
+  return std::any_cast<T>(ctx->data);
+}
+
+} // namespace purecpp
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace purecpp {
+
+/**
+ * @brief 路由规则匹配器
+ * 把限流配置中常用的正则写法编译成前缀树和通配符模式，请求路径只需要
+ * 从头到尾走一遍前缀树，不再逐条调用std::regex_match。
+ * 支持的子集：可选的^和$、普通字符、转义字符(如\.)、.(任意一个字符)、
+ * .*和.+；如"^/api/v1/.*$"、"/api/v1/user/.+"。其它写法由调用者继续用
+ * std::regex匹配。多条规则同时匹配时返回编号最小的，和按配置顺序逐条
+ * 匹配的结果一致。
+ */
+class route_matcher {
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  route_matcher() : nodes_(1) {}
+
+  /**
+   * @brief 添加一条规则
+   * @param pattern 正则表达式
+   * @param index 规则编号
+   * @return 是否编译成功，false表示超出支持的子集
+   */
+  bool add(std::string_view pattern, size_t index) {
+    std::vector<token_t> tokens;
+    if (!parse(pattern, tokens)) {
+      return false;
+    }
+
+    // 纯字面量或字面量加结尾的.*放入前缀树，其它放入通配符列表
+    size_t literal_count = 0;
+    while (literal_count < tokens.size() &&
+           tokens[literal_count].kind == token_kind::literal) {
+      ++literal_count;
+    }
+
+    bool exact = literal_count == tokens.size();
+    bool prefix = literal_count + 1 == tokens.size() &&
+                  tokens.back().kind == token_kind::any_sequence;
+    if (!exact && !prefix) {
+      globs_.push_back({std::move(tokens), index});
+      return true;
+    }
+
+    size_t node = 0;
+    for (size_t i = 0; i < literal_count; ++i) {
+      node = get_or_add_child(node, tokens[i].ch);
+    }
+    auto &target = exact ? nodes_[node].exact : nodes_[node].prefix;
+    target = std::min(target, index);
+    return true;
+  }
+
+  /**
+   * @brief 查找匹配路径的规则
+   * @param limit 只查找编号小于limit的规则
+   * @return 匹配的规则中编号最小的，没有匹配时返回npos
+   */
+  size_t match(std::string_view path, size_t limit = npos) const {
+    size_t best = limit;
+    size_t node = 0;
+    for (size_t i = 0;; ++i) {
+      best = std::min(best, nodes_[node].prefix);
+      if (i == path.size()) {
+        best = std::min(best, nodes_[node].exact);
+        break;
+      }
+      node = find_child(node, path[i]);
+      if (node == npos) {
+        break;
+      }
+    }
+
+    for (const auto &glob : globs_) {
+      if (glob.index < best && glob_match(glob.tokens, path)) {
+        best = glob.index;
+      }
+    }
+    return best == limit ? npos : best;
+  }
+
+private:
+  enum class token_kind : uint8_t { literal, any_char, any_sequence };
+
+  struct token_t {
+    token_kind kind;
+    char ch;
+  };
+
+  struct node_t {
+    std::vector<std::pair<char, size_t>> children;
+    size_t exact = npos;  // 路径在此结束时匹配的规则
+    size_t prefix = npos; // 路径以此为前缀时匹配的规则
+  };
+
+  struct glob_t {
+    std::vector<token_t> tokens;
+    size_t index;
+  };
+
+  static bool parse(std::string_view pattern, std::vector<token_t> &tokens) {
+    if (!pattern.empty() && pattern.front() == '^') {
+      pattern.remove_prefix(1);
+    }
+    if (!pattern.empty() && pattern.back() == '$' &&
+        (pattern.size() < 2 || pattern[pattern.size() - 2] != '\\')) {
+      pattern.remove_suffix(1);
+    }
+
+    constexpr std::string_view meta = "^$.*+?()[]{}|\\";
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      char c = pattern[i];
+      if (c == '\\') {
+        if (i + 1 == pattern.size() ||
+            meta.find(pattern[i + 1]) == std::string_view::npos) {
+          // \d、\w这类字符类不支持
+          return false;
+        }
+        tokens.push_back({token_kind::literal, pattern[++i]});
+      } else if (c == '.') {
+        char next = i + 1 < pattern.size() ? pattern[i + 1] : '\0';
+        if (next == '*') {
+          tokens.push_back({token_kind::any_sequence, 0});
+          ++i;
+        } else if (next == '+') {
+          tokens.push_back({token_kind::any_char, 0});
+          tokens.push_back({token_kind::any_sequence, 0});
+          ++i;
+        } else {
+          tokens.push_back({token_kind::any_char, 0});
+        }
+      } else if (meta.find(c) != std::string_view::npos) {
+        return false;
+      } else {
+        tokens.push_back({token_kind::literal, c});
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief 通配符匹配，遇到.*时记录回溯点
+   */
+  static bool glob_match(const std::vector<token_t> &tokens,
+                         std::string_view path) {
+    size_t t = 0;
+    size_t p = 0;
+    size_t star = npos;
+    size_t star_path = 0;
+    while (p < path.size()) {
+      if (t < tokens.size() && tokens[t].kind == token_kind::any_sequence) {
+        star = t++;
+        star_path = p;
+      } else if (t < tokens.size() &&
+                 (tokens[t].kind == token_kind::any_char ||
+                  tokens[t].ch == path[p])) {
+        ++t;
+        ++p;
+      } else if (star != npos) {
+        t = star + 1;
+        p = ++star_path;
+      } else {
+        return false;
+      }
+    }
+
+    while (t < tokens.size() && tokens[t].kind == token_kind::any_sequence) {
+      ++t;
+    }
+    return t == tokens.size();
+  }
+
+  size_t find_child(size_t node, char c) const {
+    for (const auto &[ch, child] : nodes_[node].children) {
+      if (ch == c) {
+        return child;
+      }
+    }
+    return npos;
+  }
+
+  size_t get_or_add_child(size_t node, char c) {
+    size_t child = find_child(node, c);
+    if (child != npos) {
+      return child;
+    }
+    child = nodes_.size();
+    nodes_.emplace_back();
+    nodes_[node].children.emplace_back(c, child);
+    return child;
+  }
+
+  std::vector<node_t> nodes_; // nodes_[0]为根节点
+  std::vector<glob_t> globs_;
+};
+
+} // namespace purecpp
@@ -0,0 +1,445 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "db_executor.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+/**
+ * @brief 搜索分词
+ * ASCII部分按标识符切分并转小写，std::shared_ptr这样的限定名同时产生
+ * std、shared_ptr和std::shared_ptr三个词，c++这样的后缀也保留；
+ * 中文按相邻两个字切分(bigram)，单独一个字时保留单字。其它字符都作为分隔符。
+ * 建索引时中文还要切出每个单字，单字的查询(如"锁")才能匹配"互斥锁"；
+ * 查询多个字时用bigram已经足够，不再切单字。
+ */
+class search_tokenizer {
+public:
+  /**
+   * @param with_unigrams 是否为连续的汉字切出每个单字，建索引时为true
+   */
+  template <typename Func>
+  static void tokenize(std::string_view text, Func &&emit,
+                       bool with_unigrams = false) {
+    size_t i = 0;
+    while (i < text.size()) {
+      unsigned char c = text[i];
+      if (is_ident_char(c)) {
+        i = read_identifier(text, i, emit);
+      } else if (c >= 0x80) {
+        i = read_cjk(text, i, emit, with_unigrams);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  static std::vector<std::string> tokenize(std::string_view text) {
+    std::vector<std::string> tokens;
+    tokenize(text, [&](std::string token) {
+      if (std::find(tokens.begin(), tokens.end(), token) == tokens.end()) {
+        tokens.push_back(std::move(token));
+      }
+    });
+    return tokens;
+  }
+
+private:
+  static bool is_ident_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+  }
+
+  static std::string to_lower(std::string_view str) {
+    std::string result(str);
+    for (auto &c : result) {
+      if (c >= 'A' && c <= 'Z') {
+        c = c - 'A' + 'a';
+      }
+    }
+    return result;
+  }
+
+  template <typename Func>
+  static size_t read_identifier(std::string_view text, size_t start,
+                                Func &emit) {
+    size_t i = start;
+    size_t part_start = start;
+    bool qualified = false;
+    while (i < text.size()) {
+      if (is_ident_char(text[i])) {
+        ++i;
+        continue;
+      }
+      // 限定名 a::b
+      if (text.substr(i, 2) == "::" && i + 2 < text.size() &&
+          is_ident_char(text[i + 2])) {
+        emit_part(text.substr(part_start, i - part_start), emit);
+        qualified = true;
+        i += 2;
+        part_start = i;
+        continue;
+      }
+      break;
+    }
+    emit_part(text.substr(part_start, i - part_start), emit);
+
+    // c++这类带++后缀的词
+    size_t end = i;
+    if (text.substr(i, 2) == "++") {
+      end += 2;
+      emit(to_lower(text.substr(part_start, end - part_start)));
+    }
+
+    if (qualified) {
+      emit(to_lower(text.substr(start, end - start)));
+    }
+    return end;
+  }
+
+  template <typename Func>
+  static void emit_part(std::string_view part, Func &emit) {
+    // 单个字母太常见，不建索引
+    if (part.size() > 1) {
+      emit(to_lower(part));
+    }
+  }
+
+  /**
+   * @brief 解码一个utf8字符
+   * @return 字符的字节数，非法编码返回1
+   */
+  static size_t decode_utf8(std::string_view text, size_t i,
+                            uint32_t &code_point) {
+    unsigned char c = text[i];
+    size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    if (len == 1 || i + len > text.size()) {
+      code_point = 0;
+      return 1;
+    }
+
+    code_point = c & (0xFF >> (len + 1));
+    for (size_t k = 1; k < len; ++k) {
+      code_point = (code_point << 6) | (text[i + k] & 0x3F);
+    }
+    return len;
+  }
+
+  static bool is_cjk(uint32_t cp) {
+    return (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF) ||
+           (cp >= 0xF900 && cp <= 0xFAFF);
+  }
+
+  template <typename Func>
+  static size_t read_cjk(std::string_view text, size_t start, Func &emit,
+                         bool with_unigrams) {
+    // 记录连续汉字中每个字的起始位置
+    std::vector<size_t> offsets;
+    size_t i = start;
+    while (i < text.size() && static_cast<unsigned char>(text[i]) >= 0x80) {
+      uint32_t cp = 0;
+      size_t len = decode_utf8(text, i, cp);
+      if (!is_cjk(cp)) {
+        if (offsets.empty()) {
+          // 不是汉字的多字节字符(如中文标点)，当作分隔符跳过
+          return i + len;
+        }
+        break;
+      }
+      offsets.push_back(i);
+      i += len;
+    }
+    offsets.push_back(i);
+
+    size_t count = offsets.size() - 1;
+    if (count == 1 || with_unigrams) {
+      for (size_t k = 0; k < count; ++k) {
+        emit(std::string(
+            text.substr(offsets[k], offsets[k + 1] - offsets[k])));
+      }
+    }
+    for (size_t k = 0; k + 1 < count; ++k) {
+      emit(std::string(text.substr(offsets[k], offsets[k + 2] - offsets[k])));
+    }
+    return i;
+  }
+};
+
+/**
+ * @brief 文章全文倒排索引
+ * 启动时加载所有未删除文章的标题、摘要和内容，之后在发布、编辑、删除时
+ * 增量更新。搜索时要求文章包含所有查询词，按词频加权(标题>摘要>内容)
+ * 和逆文档频率打分，返回排序后的文章ID，由列表查询按主键取出。
+ */
+class search_index {
+public:
+  search_index(const search_index &) = delete;
+  search_index &operator=(const search_index &) = delete;
+
+  // 按状态、标签过滤后一次搜索最多返回的文章数，更靠后的结果相关度很低，
+  // 不再翻页
+  static constexpr size_t max_search_results = 1000;
+
+  static search_index &instance() {
+    static search_index instance;
+    return instance;
+  }
+
+  /**
+   * @brief 添加或更新一篇文章的索引
+   */
+  void update(uint64_t article_id, std::string_view title,
+              std::string_view abstraction, std::string_view content) {
+    std::unordered_map<std::string, float> weights;
+    auto add = [&weights](std::string_view text, float weight) {
+      search_tokenizer::tokenize(
+          text, [&](std::string token) { weights[std::move(token)] += weight; },
+          true);
+    };
+    add(title, title_weight);
+    add(abstraction, abstraction_weight);
+    add(content, content_weight);
+
+    std::unique_lock lock(mutex_);
+    remove_locked(article_id);
+    auto &terms = doc_terms_[article_id];
+    terms.reserve(weights.size());
+    for (auto &[term, weight] : weights) {
+      postings_[term][article_id] = weight;
+      terms.push_back(term);
+    }
+  }
+
+  /**
+   * @brief 从数据库加载所有未删除的文章，分批读取避免一次占用太多内存
+   * @param conn 数据库连接
+   */
+  void load(db_conn &conn) {
+    uint64_t last_id = 0;
+    size_t total = 0;
+    while (true) {
+      auto rows =
+          conn->query_s<std::tuple<uint64_t, std::string, std::string,
+                                   std::string>>(
+              "SELECT article_id, title, abstraction, content FROM `articles` "
+              "WHERE article_id > ? AND is_deleted = 0 ORDER BY article_id "
+              "LIMIT " +
+                  std::to_string(load_batch_size),
+              last_id);
+      for (auto &[article_id, title, abstraction, content] : rows) {
+        update(article_id, title, abstraction, content);
+        last_id = article_id;
+      }
+      total += rows.size();
+      if (rows.size() < load_batch_size) {
+        break;
+      }
+    }
+    CINATRA_LOG_INFO << "search index loaded, articles: " << total;
+  }
+
+  /**
+   * @brief 删除一篇文章的索引
+   */
+  void remove(uint64_t article_id) {
+    std::unique_lock lock(mutex_);
+    remove_locked(article_id);
+  }
+
+  /**
+   * @brief 搜索包含所有查询词的文章
+   * @param query 搜索关键词
+   * @param max_results 最多返回的文章数，默认返回所有匹配的文章
+   * @return 按相关度从高到低排序的文章ID
+   */
+  std::vector<uint64_t>
+  search(std::string_view query,
+         size_t max_results = std::numeric_limits<size_t>::max()) const {
+    auto tokens = search_tokenizer::tokenize(query);
+    if (tokens.empty()) {
+      return {};
+    }
+
+    std::shared_lock lock(mutex_);
+    std::vector<const std::unordered_map<uint64_t, float> *> lists;
+    for (const auto &token : tokens) {
+      auto it = postings_.find(token);
+      if (it == postings_.end()) {
+        return {};
+      }
+      lists.push_back(&it->second);
+    }
+
+    // 从文档数最少的词开始求交集
+    std::sort(lists.begin(), lists.end(),
+              [](auto a, auto b) { return a->size() < b->size(); });
+
+    double doc_count = static_cast<double>(doc_terms_.size());
+    std::vector<std::pair<uint64_t, double>> scored;
+    for (const auto &[article_id, weight] : *lists.front()) {
+      double score = weight * idf(doc_count, lists.front()->size());
+      bool matched = true;
+      for (size_t k = 1; k < lists.size(); ++k) {
+        auto it = lists[k]->find(article_id);
+        if (it == lists[k]->end()) {
+          matched = false;
+          break;
+        }
+        score += it->second * idf(doc_count, lists[k]->size());
+      }
+      if (matched) {
+        scored.emplace_back(article_id, score);
+      }
+    }
+    lock.unlock();
+
+    size_t n = std::min(max_results, scored.size());
+    auto by_score = [](const auto &a, const auto &b) {
+      return a.second > b.second ||
+             (a.second == b.second && a.first > b.first);
+    };
+    std::partial_sort(scored.begin(), scored.begin() + n, scored.end(),
+                      by_score);
+
+    std::vector<uint64_t> result;
+    result.reserve(n);
+    for (size_t k = 0; k < n; ++k) {
+      result.push_back(scored[k].first);
+    }
+    return result;
+  }
+
+  size_t size() const {
+    std::shared_lock lock(mutex_);
+    return doc_terms_.size();
+  }
+
+private:
+  search_index() = default;
+
+  static constexpr size_t load_batch_size = 500;
+  static constexpr float title_weight = 5.0f;
+  static constexpr float abstraction_weight = 2.0f;
+  static constexpr float content_weight = 1.0f;
+
+  static double idf(double doc_count, size_t doc_freq) {
+    return std::log(1.0 + doc_count / static_cast<double>(doc_freq));
+  }
+
+  void remove_locked(uint64_t article_id) {
+    auto it = doc_terms_.find(article_id);
+    if (it == doc_terms_.end()) {
+      return;
+    }
+    for (const auto &term : it->second) {
+      auto posting = postings_.find(term);
+      if (posting == postings_.end()) {
+        continue;
+      }
+      posting->second.erase(article_id);
+      if (posting->second.empty()) {
+        postings_.erase(posting);
+      }
+    }
+    doc_terms_.erase(it);
+  }
+
+  mutable std::shared_mutex mutex_;
+  // 词 -> (文章ID -> 权重)
+  std::unordered_map<std::string, std::unordered_map<uint64_t, float>>
+      postings_;
+  // 文章ID -> 文章包含的词，用于更新和删除
+  std::unordered_map<uint64_t, std::vector<std::string>> doc_terms_;
+};
+
+inline std::string join_article_ids(const std::vector<uint64_t> &ids) {
+  std::string result;
+  for (uint64_t id : ids) {
+    if (!result.empty()) {
+      result.append(",");
+    }
+    result.append(std::to_string(id));
+  }
+  return result;
+}
+
+/**
+ * @brief 生成只保留搜索结果的sql条件，如" AND a.article_id IN (3,1,2)"
+ */
+inline std::string search_filter_sql(std::string_view id_col,
+                                     const std::vector<uint64_t> &ids) {
+  std::string sql = " AND ";
+  sql.append(id_col).append(" IN (").append(join_article_ids(ids)).append(")");
+  return sql;
+}
+
+/**
+ * @brief 按相关度顺序用sql条件过滤搜索结果
+ * 全文索引不区分文章的状态和标签，先截断再过滤时，相关度高的其它状态的
+ * 文章会占满名额(如待审核列表搜不到结果)。这里按相关度分批过滤，
+ * 凑够max_results个满足条件的文章后停止。
+ * @param from 列表查询的FROM ... WHERE ...部分，文章表的别名为a
+ * @param ranked search返回的按相关度排序的全部文章ID
+ * @return 满足条件的文章ID，保持相关度顺序，最多max_results个
+ */
+inline std::vector<uint64_t>
+filter_search_results(db_conn &conn, std::string_view from,
+                      const std::vector<uint64_t> &ranked,
+                      size_t max_results) {
+  constexpr size_t batch_size = 1000;
+  std::vector<uint64_t> result;
+  for (size_t i = 0; i < ranked.size() && result.size() < max_results;
+       i += batch_size) {
+    std::vector<uint64_t> batch(
+        ranked.begin() + i,
+        ranked.begin() + std::min(i + batch_size, ranked.size()));
+    std::string sql = "SELECT a.article_id";
+    sql.append(from).append(search_filter_sql("a.article_id", batch));
+
+    std::unordered_set<uint64_t> kept;
+    for (auto &[article_id] : conn->query_s<std::tuple<uint64_t>>(sql)) {
+      kept.insert(article_id);
+    }
+    for (uint64_t article_id : batch) {
+      if (kept.count(article_id) > 0 && result.size() < max_results) {
+        result.push_back(article_id);
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief 生成按相关度排序的分页sql
+ * 如" ORDER BY FIELD(a.article_id, 3,1,2) LIMIT 20 OFFSET 20"，
+ * 相关度不是表中的列，搜索结果只支持offset分页，不返回游标
+ */
+inline std::string search_page_sql(std::string_view id_col,
+                                   const std::vector<uint64_t> &ids,
+                                   size_t limit, size_t offset) {
+  std::string sql = " ORDER BY FIELD(";
+  sql.append(id_col)
+      .append(", ")
+      .append(join_article_ids(ids))
+      .append(") LIMIT ")
+      .append(std::to_string(limit));
+  if (offset > 0) {
+    sql.append(" OFFSET ").append(std::to_string(offset));
+  }
+  return sql;
+}
+
+} // namespace purecpp
@@ -0,0 +1,461 @@
+#pragma once
+
+#include <openssl/sha.h>
+#include <zlib.h>
+#ifdef PURECPP_ENABLE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "request_context.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 一个静态文件及其预压缩版本
+struct static_asset {
+  std::string mime;
+  std::string etag;          // 内容摘要，不带引号
+  std::string cache_control; // html每次都要验证，其它资源允许短期缓存
+  std::string identity;      // 原始内容
+  std::string gzip;          // gzip压缩后的内容，压缩收益太小时为空
+  std::string br;            // brotli压缩后的内容，压缩收益太小时为空
+  std::filesystem::file_time_type mtime;
+  uintmax_t file_size = 0;
+};
+
+/**
+ * @brief 静态资源缓存
+ * 启动时把html目录下的文件全部读入内存，文本类文件同时保存gzip和brotli
+ * 压缩后的版本，请求时按Accept-Encoding选择版本，直接带Content-Length
+ * 返回，不再每次打开文件、分块读写。ETag取内容摘要，If-None-Match
+ * 匹配时返回304。
+ * 后台线程定期检查文件的修改时间和大小，只重新读取变化的文件，
+ * 整个文件表以快照形式替换，正在处理的请求继续使用旧快照。
+ * 用户上传的文件数量不断增长，不放入缓存，由单独的路由处理。
+ */
+class static_asset_store {
+public:
+  static_asset_store(const static_asset_store &) = delete;
+  static_asset_store &operator=(const static_asset_store &) = delete;
+
+  static static_asset_store &instance() {
+    static static_asset_store instance;
+    return instance;
+  }
+
+  /**
+   * @brief 加载目录下的所有文件
+   * @param root_dir 静态资源目录
+   * @param exclude_dirs 不加载的子目录（相对root_dir）
+   */
+  void load(std::string root_dir, std::vector<std::string> exclude_dirs) {
+    {
+      std::lock_guard lock(thd_mutex_);
+      root_dir_ = std::move(root_dir);
+      exclude_dirs_ = std::move(exclude_dirs);
+    }
+    refresh();
+  }
+
+  /**
+   * @brief 按url路径查找文件，如"/css/style.css"
+   */
+  std::shared_ptr<const static_asset> find(std::string_view path) const {
+    auto assets = assets_.load(std::memory_order_acquire);
+    auto it = assets->find(path);
+    if (it == assets->end()) {
+      return nullptr;
+    }
+    return it->second;
+  }
+
+  /**
+   * @brief 启动文件检查线程
+   * @param interval_seconds 检查间隔（秒）
+   */
+  void start_watch(int interval_seconds) {
+    std::lock_guard lock(thd_mutex_);
+    if (thd_.joinable()) {
+      return;
+    }
+
+    stop_ = false;
+    interval_ = std::chrono::seconds(std::max(interval_seconds, 1));
+    thd_ = std::thread([this] {
+      std::unique_lock lock(thd_mutex_);
+      while (!stop_) {
+        cv_.wait_for(lock, interval_, [this] { return stop_; });
+        if (stop_) {
+          break;
+        }
+        lock.unlock();
+        refresh();
+        lock.lock();
+      }
+    });
+  }
+
+  void stop_watch() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (!thd_.joinable()) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thd_.join();
+  }
+
+  /**
+   * @brief 重新扫描目录，只读取新增和修改过的文件，有变化时替换快照
+   */
+  void refresh() {
+    std::string root_dir;
+    std::vector<std::string> exclude_dirs;
+    {
+      std::lock_guard lock(thd_mutex_);
+      root_dir = root_dir_;
+      exclude_dirs = exclude_dirs_;
+    }
+    if (root_dir.empty()) {
+      return;
+    }
+
+    namespace fs = std::filesystem;
+    auto old_assets = assets_.load(std::memory_order_acquire);
+    auto assets = std::make_shared<asset_map>();
+    size_t loaded = 0;
+    uint64_t bytes = 0;
+
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root_dir, ec), end;
+    if (ec) {
+      CINATRA_LOG_ERROR << "open static dir " << root_dir
+                        << " failed: " << ec.message();
+      return;
+    }
+    for (; it != end; it.increment(ec)) {
+      if (ec) {
+        CINATRA_LOG_ERROR << "scan static dir " << root_dir
+                          << " failed: " << ec.message();
+        return;
+      }
+
+      auto relative = it->path().lexically_relative(root_dir).generic_string();
+      if (it->is_directory(ec)) {
+        if (std::find(exclude_dirs.begin(), exclude_dirs.end(), relative) !=
+            exclude_dirs.end()) {
+          it.disable_recursion_pending();
+        }
+        continue;
+      }
+      if (!it->is_regular_file(ec)) {
+        continue;
+      }
+
+      std::string url_path = "/" + relative;
+      auto mtime = it->last_write_time(ec);
+      auto file_size = it->file_size(ec);
+      if (ec) {
+        continue;
+      }
+
+      auto old = old_assets->find(url_path);
+      if (old != old_assets->end() && old->second->mtime == mtime &&
+          old->second->file_size == file_size) {
+        assets->emplace(std::move(url_path), old->second);
+        continue;
+      }
+
+      auto asset = load_asset(it->path(), mtime, file_size);
+      if (asset == nullptr) {
+        continue;
+      }
+      ++loaded;
+      bytes += asset->identity.size() + asset->gzip.size() + asset->br.size();
+      assets->emplace(std::move(url_path), std::move(asset));
+    }
+
+    if (loaded == 0 && assets->size() == old_assets->size()) {
+      return;
+    }
+    CINATRA_LOG_INFO << "static assets loaded: " << loaded
+                     << " files, " << bytes << " bytes, total files: "
+                     << assets->size();
+    assets_.store(std::move(assets), std::memory_order_release);
+  }
+
+private:
+  static_asset_store() : assets_(std::make_shared<const asset_map>()) {}
+  ~static_asset_store() { stop_watch(); }
+
+  struct string_hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view sv) const {
+      return std::hash<std::string_view>{}(sv);
+    }
+  };
+
+  using asset_map =
+      std::unordered_map<std::string, std::shared_ptr<const static_asset>,
+                         string_hash, std::equal_to<>>;
+
+  static bool is_compressible(std::string_view ext) {
+    constexpr std::string_view exts[] = {
+        ".html", ".htm", ".css", ".js",  ".json", ".xml", ".svg",
+        ".txt",  ".map", ".ttf", ".otf", ".eot",  ".ico"};
+    return std::find(std::begin(exts), std::end(exts), ext) != std::end(exts);
+  }
+
+  static std::shared_ptr<static_asset>
+  load_asset(const std::filesystem::path &file_path,
+             std::filesystem::file_time_type mtime, uintmax_t file_size) {
+    std::ifstream file(file_path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      CINATRA_LOG_ERROR << "open static file failed: " << file_path;
+      return nullptr;
+    }
+
+    auto asset = std::make_shared<static_asset>();
+    asset->identity.assign(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+    asset->mtime = mtime;
+    asset->file_size = file_size;
+
+    std::string ext = file_path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    asset->mime = std::string(cinatra::get_mime_type(ext));
+    asset->cache_control = ext == ".html" || ext == ".htm"
+                               ? "no-cache"
+                               : "public, max-age=3600";
+    asset->etag = digest(asset->identity);
+
+    if (is_compressible(ext)) {
+      // 压缩后节省不到10%时不保存压缩版本
+      size_t limit = asset->identity.size() - asset->identity.size() / 10;
+      if (gzip_compress(asset->identity, asset->gzip) &&
+          asset->gzip.size() >= limit) {
+        asset->gzip.clear();
+      }
+      if (brotli_compress(asset->identity, asset->br) &&
+          asset->br.size() >= limit) {
+        asset->br.clear();
+      }
+    }
+    return asset;
+  }
+
+  // 取SHA256的前16字节作为ETag
+  static std::string digest(std::string_view content) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char *>(content.data()),
+           content.size(), hash);
+
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string result;
+    for (size_t i = 0; i < 16; ++i) {
+      result.push_back(hex[hash[i] >> 4]);
+      result.push_back(hex[hash[i] & 0x0F]);
+    }
+    return result;
+  }
+
+  static bool gzip_compress(std::string_view input, std::string &output) {
+    z_stream zs{};
+    // windowBits加16输出gzip格式
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+
+    output.resize(deflateBound(&zs, input.size()));
+    zs.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    zs.avail_in = static_cast<uInt>(input.size());
+    zs.next_out = reinterpret_cast<Bytef *>(output.data());
+    zs.avail_out = static_cast<uInt>(output.size());
+    int ret = deflate(&zs, Z_FINISH);
+    output.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END) {
+      output.clear();
+      return false;
+    }
+    return true;
+  }
+
+  static bool brotli_compress(std::string_view input, std::string &output) {
+#ifdef PURECPP_ENABLE_BROTLI
+    size_t size = BrotliEncoderMaxCompressedSize(input.size());
+    if (size == 0) {
+      return false;
+    }
+    output.resize(size);
+    if (!BrotliEncoderCompress(
+            BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+            input.size(), reinterpret_cast<const uint8_t *>(input.data()),
+            &size, reinterpret_cast<uint8_t *>(output.data()))) {
+      output.clear();
+      return false;
+    }
+    output.resize(size);
+    return true;
+#else
+    (void)input;
+    (void)output;
+    return false;
+#endif
+  }
+
+  std::atomic<std::shared_ptr<const asset_map>> assets_;
+
+  std::string root_dir_;
+  std::vector<std::string> exclude_dirs_;
+  std::thread thd_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  std::chrono::seconds interval_{5};
+  bool stop_ = false;
+};
+
+// 去掉请求头列表项两端的空白
+inline std::string_view trim_header_item(std::string_view item) {
+  auto begin = item.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  auto end = item.find_last_not_of(" \t");
+  return item.substr(begin, end - begin + 1);
+}
+
+/**
+ * @brief 判断Accept-Encoding是否接受某种编码，q=0表示明确拒绝
+ */
+inline bool accepts_encoding(std::string_view header, std::string_view name) {
+  bool wildcard = false;
+  while (!header.empty()) {
+    auto comma = header.find(',');
+    auto item = header.substr(0, comma);
+    header = comma == std::string_view::npos ? std::string_view{}
+                                             : header.substr(comma + 1);
+
+    auto semicolon = item.find(';');
+    auto coding = trim_header_item(item.substr(0, semicolon));
+    bool rejected = false;
+    if (semicolon != std::string_view::npos) {
+      auto param = trim_header_item(item.substr(semicolon + 1));
+      if (param.starts_with("q=")) {
+        auto q = param.substr(2);
+        rejected = q.find_first_not_of("0.") == std::string_view::npos;
+      }
+    }
+
+    if (cinatra::iequal0(coding, name)) {
+      return !rejected;
+    }
+    if (coding == "*") {
+      wildcard = !rejected;
+    }
+  }
+  return wildcard;
+}
+
+/**
+ * @brief 判断If-None-Match是否包含指定ETag（弱比较）
+ */
+inline bool etag_matches(std::string_view header, std::string_view etag) {
+  while (!header.empty()) {
+    auto comma = header.find(',');
+    auto tag = trim_header_item(header.substr(0, comma));
+    header = comma == std::string_view::npos ? std::string_view{}
+                                             : header.substr(comma + 1);
+    if (tag == "*") {
+      return true;
+    }
+    if (tag.starts_with("W/")) {
+      tag.remove_prefix(2);
+    }
+    if (tag == etag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief 返回缓存的静态文件，不存在时返回404
+ * @param path url路径，如"/index.html"
+ */
+inline void serve_static_asset(cinatra::coro_http_request &req,
+                               cinatra::coro_http_response &resp,
+                               std::string_view path) {
+  auto query_pos = path.find('?');
+  if (query_pos != std::string_view::npos) {
+    path = path.substr(0, query_pos);
+  }
+
+  auto asset = static_asset_store::instance().find(path);
+  if (asset == nullptr) {
+    resp.set_status(cinatra::status_type::not_found);
+    return;
+  }
+
+  // 同一内容的不同压缩版本是不同的表示，ETag要区分开
+  std::string_view body = asset->identity;
+  std::string_view encoding;
+  std::string etag = "\"" + asset->etag;
+  auto accept_encoding = req.get_header_value("Accept-Encoding");
+  if (!asset->br.empty() && accepts_encoding(accept_encoding, "br")) {
+    body = asset->br;
+    encoding = "br";
+    etag.append("-br");
+  } else if (!asset->gzip.empty() &&
+             accepts_encoding(accept_encoding, "gzip")) {
+    body = asset->gzip;
+    encoding = "gzip";
+    etag.append("-gz");
+  }
+  etag.append("\"");
+
+  if (!asset->gzip.empty() || !asset->br.empty()) {
+    resp.add_header("Vary", "Accept-Encoding");
+  }
+  resp.add_header("ETag", etag);
+  resp.add_header("Cache-Control", asset->cache_control);
+
+  if (etag_matches(req.get_header_value("If-None-Match"), etag)) {
+    resp.set_status(cinatra::status_type::not_modified);
+    return;
+  }
+
+  resp.add_header("Content-Type", asset->mime);
+  if (!encoding.empty()) {
+    resp.add_header("Content-Encoding", std::string(encoding));
+  }
+  // body直接引用快照中的数据，不复制；快照重新加载后旧的asset由请求上下文
+  // 持有到响应发送完
+  get_request_context(req)->response_owner = asset;
+  resp.set_status_and_content_view(cinatra::status_type::ok, body);
+}
+
+} // namespace purecpp
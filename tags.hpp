@@ -1,23 +1,126 @@
 #pragma once
 
 #include "common.hpp"
+#include "db_executor.hpp"
+#include "jwt_token.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 using namespace cinatra;
 
 namespace purecpp {
+
+/**
+ * @brief 标签注册表
+ * 标签几乎不会变化，启动时从数据库加载一次，之后查询全部标签、
+ * 按分组查询标签ID都直接读内存。管理员修改标签后通过reload重新加载。
+ */
+class tag_registry {
+public:
+  struct snapshot_t {
+    std::vector<tags_t> tags;
+    std::unordered_map<int, std::vector<int>> group_tag_ids; // 分组->标签ID
+    std::string tags_json; // 预先序列化好的get_tags响应
+  };
+
+  tag_registry(const tag_registry &) = delete;
+  tag_registry &operator=(const tag_registry &) = delete;
+
+  static tag_registry &instance() {
+    static tag_registry instance;
+    return instance;
+  }
+
+  /**
+   * @brief 从数据库加载所有标签，加载成功后替换当前快照
+   * @param conn 数据库连接
+   */
+  void load(db_conn &conn) {
+    auto snapshot = std::make_shared<snapshot_t>();
+    snapshot->tags = conn->select(ormpp::all).from<tags_t>().collect();
+    for (const auto &tag : snapshot->tags) {
+      snapshot->group_tag_ids[tag.tag_group].push_back(tag.tag_id);
+    }
+    snapshot->tags_json = make_data(snapshot->tags, "获取标签成功");
+
+    CINATRA_LOG_INFO << "tag registry loaded, tags: " << snapshot->tags.size();
+    std::lock_guard lock(mutex_);
+    snapshot_ = std::move(snapshot);
+  }
+
+  std::shared_ptr<const snapshot_t> snapshot() {
+    std::lock_guard lock(mutex_);
+    return snapshot_;
+  }
+
+  /**
+   * @brief 获取某个分组下的所有标签ID
+   */
+  std::vector<int> get_group_tag_ids(TagGroupType group) {
+    auto snapshot = this->snapshot();
+    auto it = snapshot->group_tag_ids.find(static_cast<int>(group));
+    if (it == snapshot->group_tag_ids.end()) {
+      return {};
+    }
+    return it->second;
+  }
+
+private:
+  tag_registry() : snapshot_(std::make_shared<snapshot_t>()) {}
+
+  std::shared_ptr<const snapshot_t> snapshot_;
+  std::mutex mutex_;
+};
+
 class tags {
 public:
   void get_tags(coro_http_request &req, coro_http_response &resp) {
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
+    auto snapshot = tag_registry::instance().snapshot();
+    resp.set_status_and_content(status_type::ok,
+                                std::string(snapshot->tags_json));
+  }
+
+  /**
+   * @brief 重新加载标签，只有管理员可以调用
+   */
+  async_simple::coro::Lazy<void> reload_tags(coro_http_request &req,
+                                             coro_http_response &resp) {
+    auto user_id = get_user_id_from_token(req);
+    if (user_id == 0) {
+      resp.set_status_and_content(status_type::unauthorized,
+                                  make_error("用户未登录或登录已过期"));
+      co_return;
     }
-    std::vector<tags_t> vec = conn->select(ormpp::all).from<tags_t>().collect();
 
-    std::string json = make_data(vec, "获取标签成功");
-    resp.set_status_and_content(status_type::ok, std::move(json));
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      auto users_vect = conn->select(ormpp::all)
+                            .from<users_t>()
+                            .where(col(&users_t::id) == user_id)
+                            .collect();
+      if (users_vect.empty()) {
+        resp.set_status_and_content(status_type::bad_request,
+                                    make_error("无效的请求参数"));
+        return;
+      }
+
+      auto &user = users_vect.front();
+      if (user.role != "admin" && user.role != "superadmin") {
+        resp.set_status_and_content(
+            status_type::forbidden,
+            make_error("权限不足，只有管理员可以重新加载标签"));
+        return;
+      }
+
+      tag_registry::instance().load(conn);
+      resp.set_status_and_content(status_type::ok,
+                                  make_success("重新加载标签成功"));
+    });
+    if (!ok) {
+      set_server_internel_error(resp);
+    }
   }
 };
-} // namespace purecpp
\ No newline at end of file
+} // namespace purecpp
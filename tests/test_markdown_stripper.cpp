@@ -0,0 +1,103 @@
+// cleanup_markdown的黄金输出测试
+// 每个用例给出输入和期望的纯文本。和原来基于std::regex的实现行为相同的
+// 用例同时与保留在这里的正则版本比较；有意改变的行为（每行开头的标题、
+// 列表、引用标记都去掉，行内代码原样保留）只比较期望输出，并确认正则
+// 版本确实不同，避免用例失去意义。
+
+#include <cstdio>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <string_view>
+
+#include "user_aspects.hpp"
+
+using namespace purecpp;
+
+namespace {
+
+// 原来的cleanup_markdown
+std::string regex_cleanup_markdown(const std::string &markdown_text) {
+  std::string text = markdown_text;
+  text = std::regex_replace(text, std::regex("!\\[(.*?)\\]\\(.*?\\)"), "$1");
+  text = std::regex_replace(text, std::regex("\\[(.*?)\\]\\(.*?\\)"), "$1");
+  text = std::regex_replace(text, std::regex("(\\*\\*|__)(.*?)\\1"), "$2");
+  text = std::regex_replace(text, std::regex("(\\*|_)(.*?)\\1"), "$2");
+  text = std::regex_replace(text, std::regex("```[\\s\\S]*?```"), "");
+  text = std::regex_replace(text, std::regex("`(.*?)`"), "$1");
+  text = std::regex_replace(text, std::regex("^#+\\s*"), "");
+  text = std::regex_replace(text, std::regex("^[*-+]\\s"), "");
+  text = std::regex_replace(text, std::regex("^>\\s"), "");
+  text = std::regex_replace(text, std::regex("\\n+"), " ");
+  return text;
+}
+
+struct golden_case {
+  std::string_view name;
+  std::string_view input;
+  std::string_view expected;
+  bool same_as_regex; // 是否和正则版本的输出相同
+};
+
+constexpr golden_case corpus[] = {
+    {"plain", "just plain text", "just plain text", true},
+    {"chinese", "中文**加粗**文本", "中文加粗文本", true},
+    {"link", "see [purecpp](http://purecpp.cn) now", "see purecpp now",
+     true},
+    {"image", "![logo](/img/logo.png) caption", "logo caption", true},
+    {"link_with_emphasis", "[**bold link**](/a)", "bold link", true},
+    {"unclosed_link", "[not a link](", "[not a link](", true},
+    {"emphasis", "**b1** *i1* __b2__ _i2_", "b1 i1 b2 i2", true},
+    {"lone_stars", "a * b * c", "a  b  c", true},
+    {"emphasis_across_lines", "*start\nend* rest", "*start end* rest",
+     true},
+    {"code_fence", "before\n```cpp\nint *p = nullptr;\n```\nafter",
+     "before after", true},
+    {"unclosed_fence", "```\nint a;", "` int a;", true},
+    {"first_heading", "# Title\nbody", "Title body", true},
+    {"hashtag", "#tag", "tag", true},
+    {"first_quote", "> quoted", "quoted", true},
+    {"first_list_star", "* item", "item", true},
+    {"newlines", "line1\n\n\nline2\n", "line1 line2 ", true},
+    {"empty", "", "", true},
+
+    // 每行开头的标记都去掉，正则版本只处理整个文本的开头
+    {"every_heading", "# One\ntext\n## Two", "One text Two", false},
+    {"every_list", "- a\n- b\n+ c", "a b c", false},
+    {"every_quote", "> first\n> second", "first second", false},
+    {"nested_prefix_once", "text\n> - item", "text - item", false},
+
+    // 行内代码原样保留，正则版本会把其中的*和_当作强调去掉
+    {"inline_code_star", "use `a*b*c` here", "use a*b*c here", false},
+    {"inline_code_underscore", "`snake_case_name`", "snake_case_name",
+     false},
+    {"inline_code_link", "`[x](y)` is a link", "[x](y) is a link", false},
+};
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  std::string out;
+  for (const auto &c : corpus) {
+    cleanup_markdown(c.input, out);
+    if (out != c.expected) {
+      ++failures;
+      std::printf("%.*s: expected \"%.*s\", got \"%s\"\n", int(c.name.size()),
+                  c.name.data(), int(c.expected.size()), c.expected.data(),
+                  out.c_str());
+    }
+
+    std::string regex_out = regex_cleanup_markdown(std::string(c.input));
+    if ((regex_out == c.expected) != c.same_as_regex) {
+      ++failures;
+      std::printf("%.*s: regex version gives \"%s\", same_as_regex should be "
+                  "%s\n",
+                  int(c.name.size()), c.name.data(), regex_out.c_str(),
+                  c.same_as_regex ? "false" : "true");
+    }
+  }
+
+  std::printf("checked %zu cases, %d failures\n", std::size(corpus), failures);
+  return failures == 0 ? 0 : 1;
+}
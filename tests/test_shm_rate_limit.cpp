@@ -0,0 +1,142 @@
+// shm_rate_limit_backend的多进程测试
+// fork两个子进程，分别打开同一个共享文件并同时对同一个key发请求，两个
+// 进程放行的请求数之和必须正好等于规则的上限，超过上限后父进程看到的也是
+// 封禁状态。各进程各算各的时每个进程都会放行max_requests个请求。
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include "rate_limit_backend.hpp"
+
+using namespace purecpp;
+
+namespace {
+
+constexpr size_t max_keys = 1024;
+constexpr int requests_per_process = 300;
+constexpr uint64_t client_key = 0x9E3779B97F4A7C15;
+// 固定的时间戳，位于窗口开头，两个进程的请求落在同一个窗口内
+constexpr uint64_t now = 1700000000000 / 60000 * 60000 + 1;
+
+const rate_limit_rule rule{"/api/v1/login", 100, 60};
+
+int failures = 0;
+
+void expect(bool ok, const char *what) {
+  if (!ok) {
+    ++failures;
+    std::printf("failed: %s\n", what);
+  }
+}
+
+/**
+ * @brief 子进程：打开共享文件，通知父进程已就绪，等父进程放行后发请求，
+ * 放行的请求数通过管道写回
+ */
+[[noreturn]] void run_child(const std::string &path, int ready_fd, int go_fd,
+                            int result_fd) {
+  auto backend = shm_rate_limit_backend::open(path, max_keys);
+  if (backend == nullptr) {
+    _exit(2);
+  }
+
+  char c = 'r';
+  if (write(ready_fd, &c, 1) != 1) {
+    _exit(3);
+  }
+  // 父进程关闭写端后read返回0，两个子进程同时开始
+  while (read(go_fd, &c, 1) > 0) {
+  }
+
+  int allowed = 0;
+  for (int i = 0; i < requests_per_process; ++i) {
+    if (backend->hit(client_key, rule, now) == rate_limit_result::ALLOWED) {
+      ++allowed;
+    }
+  }
+  if (write(result_fd, &allowed, sizeof(allowed)) != sizeof(allowed)) {
+    _exit(4);
+  }
+  _exit(0);
+}
+
+} // namespace
+
+int main() {
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("purecpp_rate_limit_test_" + std::to_string(getpid())))
+                         .string();
+  std::filesystem::remove(path);
+
+  int ready[2], go[2], result[2];
+  if (pipe(ready) != 0 || pipe(go) != 0 || pipe(result) != 0) {
+    std::perror("pipe");
+    return 1;
+  }
+
+  pid_t children[2];
+  for (auto &child : children) {
+    child = fork();
+    if (child < 0) {
+      std::perror("fork");
+      return 1;
+    }
+    if (child == 0) {
+      close(go[1]);
+      run_child(path, ready[1], go[0], result[1]);
+    }
+  }
+  close(go[0]);
+  close(ready[1]);
+  close(result[1]);
+
+  char c;
+  for (int i = 0; i < 2; ++i) {
+    expect(read(ready[0], &c, 1) == 1, "child opened the shared file");
+  }
+  close(go[1]);
+
+  int total_allowed = 0;
+  for (int i = 0; i < 2; ++i) {
+    int allowed = 0;
+    expect(read(result[0], &allowed, sizeof(allowed)) == sizeof(allowed),
+           "child reported its count");
+    std::printf("child %d allowed %d of %d\n", i, allowed,
+                requests_per_process);
+    total_allowed += allowed;
+  }
+  for (auto child : children) {
+    int status = 0;
+    waitpid(child, &status, 0);
+    expect(WIFEXITED(status) && WEXITSTATUS(status) == 0, "child exit code");
+  }
+
+  std::printf("total allowed %d, limit %d\n", total_allowed,
+              rule.max_requests);
+  expect(total_allowed == rule.max_requests,
+         "combined allowed requests equal the limit");
+
+  auto backend = shm_rate_limit_backend::open(path, max_keys);
+  expect(backend != nullptr, "parent attaches to the shared file");
+  if (backend != nullptr) {
+    expect(backend->stats().tracked_keys == 1, "one key tracked");
+    expect(backend->blocked_until(client_key) > now, "key is blocked");
+    expect(backend->hit(client_key, rule, now + 1) ==
+               rate_limit_result::BLOCKED,
+           "parent sees the block");
+  }
+
+  // 记录上限不同的进程不能附加到同一个文件
+  expect(shm_rate_limit_backend::open(path, max_keys * 4) == nullptr,
+         "size mismatch is rejected");
+
+  backend.reset();
+  std::filesystem::remove(path);
+  std::printf("%d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// 注册校验函数的性质测试
+// 用固定种子生成大量随机输入，逐个比较is_valid_username、
+// validate_email_format、validate_password_complexity和原来基于
+// std::regex的实现，结果必须完全一致。
+
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+
+#include "user_aspects.hpp"
+
+using namespace purecpp;
+
+namespace {
+
+// 原来check_user_name中的正则
+bool regex_username(const std::string &username) {
+  static const std::regex username_regex("^[a-zA-Z0-9_-]+$");
+  return std::regex_match(username, username_regex);
+}
+
+// 原来validate_email_format的实现
+bool regex_email(const std::string &email) {
+  if (email.empty() || email.size() > 254) {
+    return false;
+  }
+  static const std::regex email_regex(
+      R"([a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,})");
+  return std::regex_match(email, email_regex);
+}
+
+// 原来validate_password_complexity的规则，用正则表示
+bool regex_password(const std::string &password) {
+  static const std::regex upper("[A-Z]");
+  static const std::regex lower("[a-z]");
+  static const std::regex digit("[0-9]");
+  return password.size() >= 6 && password.size() <= 20 &&
+         std::regex_search(password, upper) &&
+         std::regex_search(password, lower) &&
+         std::regex_search(password, digit);
+}
+
+int failures = 0;
+
+void report(const char *name, const std::string &input, bool expected,
+            bool actual) {
+  if (expected == actual) {
+    return;
+  }
+  if (++failures <= 20) {
+    std::string escaped;
+    for (unsigned char c : input) {
+      if (c < 0x20 || c >= 0x7F) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\x%02X", c);
+        escaped.append(buf);
+      } else {
+        escaped.push_back(char(c));
+      }
+    }
+    std::printf("%s mismatch: \"%s\", regex: %d, scanner: %d\n", name,
+                escaped.c_str(), expected, actual);
+  }
+}
+
+void check_all(const std::string &input) {
+  report("username", input, regex_username(input), is_valid_username(input));
+  report("email", input, regex_email(input),
+         validate_email_format(input).first);
+  report("password", input, regex_password(input),
+         validate_password_complexity(input).first);
+}
+
+class input_generator {
+public:
+  explicit input_generator(uint32_t seed) : rng_(seed) {}
+
+  // 从alphabet中随机取字符，长度[0, max_len]
+  std::string pick(std::string_view alphabet, size_t max_len) {
+    size_t len = std::uniform_int_distribution<size_t>(0, max_len)(rng_);
+    std::uniform_int_distribution<size_t> index(0, alphabet.size() - 1);
+    std::string out;
+    for (size_t i = 0; i < len; ++i) {
+      out.push_back(alphabet[index(rng_)]);
+    }
+    return out;
+  }
+
+  // 由本地部分、@、域名、点和顶级域拼成，各部分可能为空或含非法字符，
+  // 大部分输入落在正则的边界附近
+  std::string email() {
+    static constexpr std::string_view local = "aZ09._%+-";
+    static constexpr std::string_view domain = "aZ09.-";
+    static constexpr std::string_view tld = "abZ1-";
+    std::string out = pick(local, 6);
+    if (chance(10)) {
+      out.append(pick(noise, 2));
+    }
+    if (!chance(5)) {
+      out.push_back('@');
+    }
+    out.append(pick(domain, 6));
+    if (!chance(5)) {
+      out.push_back('.');
+    }
+    out.append(pick(tld, 4));
+    if (chance(10)) {
+      out.append(pick(noise, 2));
+    }
+    return out;
+  }
+
+  bool chance(int one_in) {
+    return std::uniform_int_distribution<int>(0, one_in - 1)(rng_) == 0;
+  }
+
+  // 非ASCII字节、空白和其它标点
+  static constexpr std::string_view noise = "\xE4\xB8\x80\x80\xFF \t\n@#!~";
+
+private:
+  std::mt19937 rng_;
+};
+
+} // namespace
+
+int main() {
+  const std::string fixed[] = {
+      "",
+      "a",
+      "user_name-01",
+      "user name",
+      "用户",
+      "a@b.co",
+      "a@b.c",
+      "a@.co",
+      "@b.co",
+      "a@b.co.",
+      "a@b..co",
+      "a.b+c%d@x-y.example.COM",
+      "a@b@c.co",
+      "a@b.c0m",
+      std::string(243, 'a') + "@example.com",
+      std::string(244, 'a') + "@example.com",
+      "Abc123",
+      "abc123",
+      "ABC123",
+      "Abcdef",
+      "Ab1",
+      "Abcdefghij1234567890",
+      "Abcdefghij12345678901",
+      "\xC3\x80" "bc123a",
+  };
+  for (const auto &input : fixed) {
+    check_all(input);
+  }
+
+  input_generator gen(20251016);
+  static constexpr std::string_view alphabet =
+      "aAzZ09_-.@%+ \t\xE4\x80\xFF";
+  size_t count = std::size(fixed);
+  for (int i = 0; i < 200000; ++i, count += 2) {
+    check_all(gen.pick(alphabet, 24));
+    check_all(gen.email());
+  }
+
+  std::printf("checked %zu inputs, %d mismatches\n", count, failures);
+  return failures == 0 ? 0 : 1;
+}
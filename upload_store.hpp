@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "upload_stream.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+/**
+ * @brief 按内容寻址的上传文件存储
+ * 文件以内容的SHA-256命名，按摘要前两位分目录保存，如
+ * articles/3f/3fa2...e1.png。内存中保存摘要到url的索引，同样内容再次上传
+ * 时直接返回已有文件的url：multipart上传边收边算摘要，收完后发现重复时
+ * 丢弃临时文件；json上传的内容已在内存中，写盘前就能算出摘要，完全不写
+ * 文件。
+ * 相同内容不同扩展名的上传也复用第一次保存的文件。
+ */
+class upload_store {
+public:
+  upload_store(const upload_store &) = delete;
+  upload_store &operator=(const upload_store &) = delete;
+
+  static upload_store &instance() {
+    static upload_store instance;
+    return instance;
+  }
+
+  /**
+   * @brief 扫描已保存的文件建立索引
+   * @param root_dir 保存目录，如"html/uploads/articles"
+   * @param url_prefix 目录对应的url，如"/uploads/articles"
+   */
+  void load(std::string root_dir, std::string url_prefix) {
+    namespace fs = std::filesystem;
+    std::unique_lock lock(mutex_);
+    root_dir_ = std::move(root_dir);
+    url_prefix_ = std::move(url_prefix);
+    index_.clear();
+
+    std::error_code ec;
+    for (fs::directory_iterator shard(root_dir_, ec), end; !ec && shard != end;
+         shard.increment(ec)) {
+      std::string prefix = shard->path().filename().string();
+      if (!shard->is_directory(ec) || prefix.size() != 2) {
+        continue;
+      }
+      for (fs::directory_iterator it(shard->path(), ec); !ec && it != end;
+           it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        std::string digest = name.substr(0, name.find('.'));
+        if (is_digest(digest) && digest.starts_with(prefix)) {
+          std::string ext = it->path().extension().string();
+          index_.emplace(digest, url_for(digest, ext));
+        }
+      }
+      ec.clear();
+    }
+    CINATRA_LOG_INFO << "upload store loaded: " << root_dir_
+                     << ", files: " << index_.size();
+  }
+
+  /**
+   * @brief 保存multipart请求体中的文件
+   * @param ext 小写扩展名，如".png"
+   * @return 文件url，失败时返回nullopt并已设置错误响应
+   */
+  async_simple::coro::Lazy<std::optional<std::string>>
+  save(coro_http_request &req, coro_http_response &resp, std::string_view ext,
+       size_t max_size, std::string_view size_error) {
+    auto tmp_path = make_tmp_path();
+    sha256_hasher hasher;
+    if (!co_await write_upload(req, resp, tmp_path, max_size, size_error,
+                               &hasher)) {
+      co_return std::nullopt;
+    }
+
+    auto url = co_await commit(tmp_path, hasher.final_hex(), ext);
+    if (!url) {
+      set_server_internel_error(resp);
+    }
+    co_return url;
+  }
+
+  /**
+   * @brief 保存内存中的文件内容，用于json上传
+   * @param data 文件内容，协程完成前必须保持有效
+   * @return 文件url，失败时返回nullopt并已设置错误响应
+   */
+  async_simple::coro::Lazy<std::optional<std::string>>
+  save(coro_http_response &resp, std::string_view data, std::string_view ext) {
+    std::string digest = sha256_hex(data);
+    if (auto url = find(digest)) {
+      deduplicated_.fetch_add(1, std::memory_order_relaxed);
+      co_return url;
+    }
+
+    auto tmp_path = make_tmp_path();
+    auto &sink = file_sink::instance();
+    file_sink_writer out_file;
+    auto status = co_await sink.open(out_file, tmp_path);
+    if (status == sink_status::ok &&
+        (!co_await sink.write(out_file, data) ||
+         !co_await sink.commit(out_file))) {
+      status = sink_status::failed;
+    }
+    if (status != sink_status::ok) {
+      set_file_sink_error(resp, status);
+      co_return std::nullopt;
+    }
+
+    auto url = co_await commit(tmp_path, digest, ext);
+    if (!url) {
+      set_server_internel_error(resp);
+    }
+    co_return url;
+  }
+
+  std::optional<std::string> find(const std::string &digest) const {
+    std::shared_lock lock(mutex_);
+    auto it = index_.find(digest);
+    if (it == index_.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  size_t size() const {
+    std::shared_lock lock(mutex_);
+    return index_.size();
+  }
+
+  // 因内容重复而没有保存新文件的上传次数
+  uint64_t deduplicated() const {
+    return deduplicated_.load(std::memory_order_relaxed);
+  }
+
+private:
+  upload_store() = default;
+
+  static bool is_digest(std::string_view name) {
+    return name.size() == 64 &&
+           name.find_first_not_of("0123456789abcdef") == std::string::npos;
+  }
+
+  // 临时文件放在根目录下，和最终文件在同一个文件系统，重命名是原子的，
+  // 目录由file_sink打开文件时创建
+  std::filesystem::path make_tmp_path() {
+    return std::filesystem::path(root_dir_) /
+           (".upload_" + std::to_string(tmp_seq_.fetch_add(1)) + "_" +
+            std::to_string(get_timestamp_milliseconds()) + ".tmp");
+  }
+
+  std::string url_for(const std::string &digest, std::string_view ext) const {
+    std::string url = url_prefix_;
+    url.append("/").append(digest, 0, 2).append("/").append(digest);
+    url.append(ext);
+    return url;
+  }
+
+  /**
+   * @brief 把写好的临时文件移动到摘要对应的位置并加入索引
+   * 重命名在文件线程池上执行，不持有锁。两个相同内容的上传同时提交时，
+   * 后提交的直接丢弃临时文件；都已经开始重命名时，内容相同，后一次覆盖
+   * 前一次，索引只保留先加入的url。
+   */
+  async_simple::coro::Lazy<std::optional<std::string>>
+  commit(const std::filesystem::path &tmp_path, const std::string &digest,
+         std::string_view ext) {
+    auto &sink = file_sink::instance();
+    if (auto url = find(digest)) {
+      co_await sink.remove(tmp_path);
+      deduplicated_.fetch_add(1, std::memory_order_relaxed);
+      co_return url;
+    }
+
+    auto file_path = std::filesystem::path(root_dir_) / digest.substr(0, 2) /
+                     (digest + std::string(ext));
+    if (!co_await sink.rename(tmp_path, file_path)) {
+      co_return std::nullopt;
+    }
+
+    std::unique_lock lock(mutex_);
+    auto [it, inserted] = index_.emplace(digest, url_for(digest, ext));
+    if (!inserted) {
+      deduplicated_.fetch_add(1, std::memory_order_relaxed);
+    }
+    co_return it->second;
+  }
+
+  mutable std::shared_mutex mutex_;
+  std::string root_dir_ = "html/uploads/articles";
+  std::string url_prefix_ = "/uploads/articles";
+  std::unordered_map<std::string, std::string> index_; // 摘要 -> url
+  std::atomic<uint64_t> tmp_seq_{0};
+  std::atomic<uint64_t> deduplicated_{0};
+};
+
+} // namespace purecpp
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "common.hpp"
+#include "error_info.hpp"
+#include "file_sink.hpp"
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+// 上传成功的响应
+struct upload_response {
+  std::string url;
+  std::string filename;
+};
+
+// 请求体直接上传时允许的图片格式，pdf、txt需要检查内容，仍走json上传
+inline constexpr std::array<std::string_view, 4> RAW_UPLOAD_EXTENSIONS = {
+    ".jpg", ".jpeg", ".png", ".gif"};
+
+// multipart请求体中分隔符和各部分头部允许占用的字节数
+inline constexpr size_t MAX_MULTIPART_OVERHEAD = 4096;
+
+/**
+ * @brief 从?filename=xxx.png中取出小写的扩展名，不支持的格式返回空
+ */
+inline std::string get_raw_upload_extension(coro_http_request &req) {
+  std::string ext(cinatra::get_extension(req.get_query_value("filename")));
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (std::find(RAW_UPLOAD_EXTENSIONS.begin(), RAW_UPLOAD_EXTENSIONS.end(),
+                ext) == RAW_UPLOAD_EXTENSIONS.end()) {
+    return {};
+  }
+  return ext;
+}
+
+/**
+ * @brief 流式计算SHA-256
+ */
+class sha256_hasher {
+public:
+  sha256_hasher() : ctx_(EVP_MD_CTX_new(), EVP_MD_CTX_free) {
+    EVP_DigestInit_ex(ctx_.get(), EVP_sha256(), nullptr);
+  }
+
+  void update(std::string_view data) {
+    EVP_DigestUpdate(ctx_.get(), data.data(), data.size());
+  }
+
+  /**
+   * @brief 结束计算，返回64位小写十六进制摘要
+   */
+  std::string final_hex() {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    EVP_DigestFinal_ex(ctx_.get(), hash, &len);
+
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(len * 2);
+    for (unsigned int i = 0; i < len; ++i) {
+      result.push_back(hex[hash[i] >> 4]);
+      result.push_back(hex[hash[i] & 0x0F]);
+    }
+    return result;
+  }
+
+private:
+  std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx_;
+};
+
+inline std::string sha256_hex(std::string_view data) {
+  sha256_hasher hasher;
+  hasher.update(data);
+  return hasher.final_hex();
+}
+
+/**
+ * @brief 把multipart请求体中的文件写入临时文件
+ * 浏览器用FormData上传文件，框架不预先读取multipart请求体，由这里逐个
+ * 读取各部分，保存第一个带文件名的部分，其它字段忽略。Content-Length
+ * 超过上限时不读取请求体直接拒绝；读取过程中累计各部分的大小，超过上限
+ * 立即停止，内存占用只有一个部分。写盘由file_sink在文件线程池上执行。
+ * 失败时设置错误响应并删除临时文件。
+ * @param tmp_path 临时文件路径，所在目录不存在时创建
+ * @param max_size 文件大小上限（字节）
+ * @param size_error 超过上限时返回的错误信息
+ * @param hasher 不为空时同时计算写入内容的摘要
+ * @return 是否写入成功
+ */
+inline async_simple::coro::Lazy<bool>
+write_upload(coro_http_request &req, coro_http_response &resp,
+             const std::filesystem::path &tmp_path, size_t max_size,
+             std::string_view size_error, sha256_hasher *hasher = nullptr) {
+  // 没有提交的临时文件在out_file析构时删除
+  auto fail = [&](status_type status, std::string_view message) {
+    resp.set_status_and_content(status, make_error(message));
+  };
+
+  if (req.get_content_type() != content_type::multipart) {
+    fail(status_type::bad_request, PURECPP_ERROR_UPLOAD_NOT_MULTIPART);
+    co_return false;
+  }
+  auto content_length = req.get_header_value("Content-Length");
+  size_t length = 0;
+  auto [ptr, ec] =
+      std::from_chars(content_length.data(),
+                      content_length.data() + content_length.size(), length);
+  if (ec == std::errc{} && length > max_size + MAX_MULTIPART_OVERHEAD) {
+    fail(status_type::bad_request, size_error);
+    co_return false;
+  }
+
+  auto &sink = file_sink::instance();
+  file_sink_writer out_file;
+  auto status = co_await sink.open(out_file, tmp_path);
+  if (status != sink_status::ok) {
+    set_file_sink_error(resp, status);
+    co_return false;
+  }
+
+  auto boundary = req.get_boundary();
+  multipart_reader_t multipart(req.get_conn());
+  size_t total = 0;
+  size_t file_size = 0;
+  bool found = false;
+  while (true) {
+    auto part_head = co_await multipart.read_part_head(boundary);
+    if (part_head.ec) {
+      fail(status_type::bad_request, "读取上传数据失败");
+      co_return false;
+    }
+    auto part_body = co_await multipart.read_part_body(boundary);
+    if (part_body.ec) {
+      fail(status_type::bad_request, "读取上传数据失败");
+      co_return false;
+    }
+
+    total += part_body.data.size();
+    if (total > max_size) {
+      fail(status_type::bad_request, size_error);
+      co_return false;
+    }
+    if (!found && !part_head.filename.empty()) {
+      found = true;
+      file_size = part_body.data.size();
+      if (hasher != nullptr) {
+        hasher->update(part_body.data);
+      }
+      if (!co_await sink.write(out_file, part_body.data)) {
+        CINATRA_LOG_ERROR << "write upload file failed: " << tmp_path;
+        fail(status_type::internal_server_error, "保存文件失败");
+        co_return false;
+      }
+    }
+    if (part_body.eof) {
+      break;
+    }
+  }
+  if (file_size == 0) {
+    fail(status_type::bad_request, PURECPP_ERROR_UPLOAD_FILE_EMPTY);
+    co_return false;
+  }
+  if (!co_await sink.commit(out_file)) {
+    CINATRA_LOG_ERROR << "write upload file failed: " << tmp_path;
+    fail(status_type::internal_server_error, "保存文件失败");
+    co_return false;
+  }
+  co_return true;
+}
+
+/**
+ * @brief 把multipart请求体中的文件保存为dir/file_name
+ * 先写入临时文件，写完后重命名，其它请求不会读到写了一半的文件。
+ * @return 是否保存成功，失败时已设置错误响应
+ */
+inline async_simple::coro::Lazy<bool>
+receive_upload(coro_http_request &req, coro_http_response &resp,
+               const std::filesystem::path &dir, const std::string &file_name,
+               size_t max_size, std::string_view size_error) {
+  auto tmp_path = dir / ("." + file_name + ".tmp");
+  if (!co_await write_upload(req, resp, tmp_path, max_size, size_error)) {
+    co_return false;
+  }
+
+  if (!co_await file_sink::instance().rename(tmp_path, dir / file_name)) {
+    set_server_internel_error(resp);
+    co_return false;
+  }
+  co_return true;
+}
+
+} // namespace purecpp
@@ -6,9 +6,9 @@
 #include "rate_limiter.hpp"
 #include "user_dto.hpp"
 #include <any>
+#include <array>
 #include <chrono>
 #include <iomanip>
-#include <regex>
 #include <sstream>
 #include <string_view>
 #include <system_error>
@@ -53,14 +53,14 @@ struct check_register_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
 
 struct check_cpp_answer {
   bool before(coro_http_request &req, coro_http_response &res) {
-    register_info info = std::any_cast<register_info>(req.get_user_data());
+    register_info info = get_request_data<register_info>(req);
     bool r = cpp_answers[info.question_index] == info.cpp_answer;
 
     if (!r) {
@@ -72,53 +72,237 @@ struct check_cpp_answer {
   }
 };
 
-std::string cleanup_markdown(const std::string &markdown_text) {
-  std::string text = markdown_text;
+/**
+ * @brief 去掉markdown标记，只保留纯文本
+ * 一次线性扫描完成：图片和链接保留文字，粗体、斜体和行内代码保留内容，
+ * 代码块整块去掉，每行开头的标题、列表和引用标记去掉，连续换行合并成
+ * 一个空格。除代码块外，成对的标记只在同一行内匹配。
+ */
+class markdown_stripper {
+public:
+  void strip(std::string_view text, std::string &out) {
+    text_ = text;
+    out.clear();
+    out.reserve(text.size());
+    for (auto &f : finders_) {
+      f.valid = false;
+    }
+
+    size_t pos = 0;
+    bool line_start = true;
+    // 上一个换行产生的空格之后的输出长度，去掉代码块后前后的换行要合并
+    size_t newline_space_end = std::string::npos;
+    while (pos < text_.size()) {
+      if (line_start) {
+        pos = skip_line_prefix(pos);
+        line_start = false;
+        continue;
+      }
+
+      if (text_[pos] == '\n') {
+        if (out.size() != newline_space_end) {
+          out.push_back(' ');
+          newline_space_end = out.size();
+        }
+        while (pos < text_.size() && text_[pos] == '\n') {
+          ++pos;
+        }
+        line_start = true;
+        continue;
+      }
+
+      // 代码块可以跨行，整块去掉
+      if (text_.substr(pos, 3) == "```") {
+        size_t close = find(fence, pos + 3);
+        if (close != std::string_view::npos) {
+          pos = close + 3;
+          continue;
+        }
+      }
+
+      size_t line_end = find(newline, pos);
+      if (line_end == std::string_view::npos) {
+        line_end = text_.size();
+      }
+      pos = strip_span(pos, line_end, out);
+    }
+  }
+
+private:
+  enum needle_index {
+    newline,
+    fence,
+    link_mid,
+    link_end,
+    backtick,
+    bold_star,
+    bold_underscore,
+    star,
+    underscore,
+    needle_count
+  };
+
+  /**
+   * @brief 记住上一次查找的起点和结果
+   * 扫描位置只会向后移动，上次的结果在当前位置之后就可以直接复用，
+   * 避免"[[[[..."这样的输入反复扫描到行尾，保证整体是线性的
+   */
+  struct finder_t {
+    std::string_view needle;
+    size_t from = 0;
+    size_t found = 0;
+    bool valid = false;
+  };
+
+  size_t find(needle_index index, size_t pos) {
+    auto &f = finders_[index];
+    if (!f.valid || pos < f.from ||
+        (f.found != std::string_view::npos && f.found < pos)) {
+      f.from = pos;
+      f.found = text_.find(f.needle, pos);
+      f.valid = true;
+    }
+    return f.found;
+  }
+
+  /**
+   * @brief 跳过行首的标题(#)、列表(- * +)和引用(>)标记
+   */
+  size_t skip_line_prefix(size_t pos) const {
+    auto is_blank = [this](size_t i) {
+      return i < text_.size() && (text_[i] == ' ' || text_[i] == '\t');
+    };
+
+    char c = text_[pos];
+    if (c == '#') {
+      while (pos < text_.size() && text_[pos] == '#') {
+        ++pos;
+      }
+      while (is_blank(pos)) {
+        ++pos;
+      }
+      return pos;
+    }
 
-  // 1. 清理链接和图片 (保留链接文本)
-  // 匹配 [text](url) 或 ![text](url)
-  text = std::regex_replace(text, std::regex("!\\[(.*?)\\]\\(.*?\\)"),
-                            "$1"); // 图片
-  text = std::regex_replace(text, std::regex("\\[(.*?)\\]\\(.*?\\)"),
-                            "$1"); // 链接
+    if ((c == '-' || c == '*' || c == '+' || c == '>') && is_blank(pos + 1)) {
+      return pos + 2;
+    }
+    return pos;
+  }
 
-  // 2. 清理粗体和斜体 (**bold** or *italic*)
-  // 匹配 **...** 和 *...*
-  text = std::regex_replace(text, std::regex("(\\*\\*|__)(.*?)\\1"), "$2");
-  text = std::regex_replace(text, std::regex("(\\*|_)(.*?)\\1"), "$2");
+  void strip_range(size_t pos, size_t end, std::string &out) {
+    while (pos < end) {
+      pos = strip_span(pos, end, out);
+    }
+  }
+
+  /**
+   * @brief 处理从pos开始的一个行内标记
+   * @param end 当前行(或外层标记内容)的结束位置，成对的标记必须在此之前闭合
+   * @return 处理完后的位置
+   */
+  size_t strip_span(size_t pos, size_t end, std::string &out) {
+    char c = text_[pos];
+
+    // 图片![text](url)和链接[text](url)，保留text
+    size_t bracket = c == '!' ? pos + 1 : pos;
+    if (bracket < end && text_[bracket] == '[') {
+      size_t mid = find(link_mid, bracket + 1);
+      size_t close =
+          mid < end ? find(link_end, mid + 2) : std::string_view::npos;
+      if (close < end) {
+        strip_range(bracket + 1, mid, out);
+        return close + 1;
+      }
+    }
 
-  // 3. 清理代码块和行内代码 (```code``` or `code`)
-  text = std::regex_replace(text, std::regex("```[\\s\\S]*?```"),
-                            "");                                // 移除代码块
-  text = std::regex_replace(text, std::regex("`(.*?)`"), "$1"); // 行内代码
+    // 粗体**text**、__text__和斜体*text*、_text_
+    if (c == '*' || c == '_') {
+      if (pos + 1 < end && text_[pos + 1] == c) {
+        size_t close = find(c == '*' ? bold_star : bold_underscore, pos + 2);
+        if (close < end) {
+          strip_range(pos + 2, close, out);
+          return close + 2;
+        }
+      }
 
-  // 4. 清理标题 (# H1, ## H2, etc.)
-  text = std::regex_replace(text, std::regex("^#+\\s*"), "");
+      size_t close = find(c == '*' ? star : underscore, pos + 1);
+      if (close < end) {
+        strip_range(pos + 1, close, out);
+        return close + 1;
+      }
+    }
 
-  // 5. 清理列表和引用 (> quote)
-  text = std::regex_replace(text, std::regex("^[*-+]\\s"), ""); // 列表
-  text = std::regex_replace(text, std::regex("^>\\s"), "");     // 引用
+    // 行内代码`code`，保留代码原样
+    if (c == '`') {
+      size_t close = find(backtick, pos + 1);
+      if (close < end) {
+        out.append(text_.substr(pos + 1, close - pos - 1));
+        return close + 1;
+      }
+    }
 
-  // 6. 最终清理多余的换行和空格
-  // 替换多个换行符为一个空格（将段落连起来）
-  text = std::regex_replace(text, std::regex("\\n+"), " ");
+    out.push_back(c);
+    return pos + 1;
+  }
 
+  std::string_view text_;
+  std::array<finder_t, needle_count> finders_{
+      finder_t{"\n"}, finder_t{"```"}, finder_t{"]("}, finder_t{")"},
+      finder_t{"`"},  finder_t{"**"},  finder_t{"__"}, finder_t{"*"},
+      finder_t{"_"}};
+};
+
+/**
+ * @brief 去掉markdown标记，结果写入out，out的内存可以在多次调用间复用
+ */
+inline void cleanup_markdown(std::string_view markdown_text,
+                             std::string &out) {
+  markdown_stripper{}.strip(markdown_text, out);
+}
+
+inline std::string cleanup_markdown(std::string_view markdown_text) {
+  std::string text;
+  cleanup_markdown(markdown_text, text);
   return text;
 }
 
+// 以下校验函数只按ASCII字符类扫描输入，不构造正则、不分配内存
+inline bool is_ascii_alpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+inline bool is_ascii_digit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool is_ascii_alnum(char c) {
+  return is_ascii_alpha(c) || is_ascii_digit(c);
+}
+
+/**
+ * @brief 用户名只允许字母、数字、下划线和连字符，等价于^[a-zA-Z0-9_-]+$
+ */
+inline bool is_valid_username(std::string_view username) {
+  if (username.empty()) {
+    return false;
+  }
+  for (char c : username) {
+    if (!is_ascii_alnum(c) && c != '_' && c != '-') {
+      return false;
+    }
+  }
+  return true;
+}
+
 struct check_user_name {
   bool before(coro_http_request &req, coro_http_response &res) {
-    register_info info = std::any_cast<register_info>(req.get_user_data());
+    register_info info = get_request_data<register_info>(req);
     if (info.username.empty() || info.username.size() > 20) {
       res.set_status_and_content(status_type::bad_request,
                                  make_error("用户名长度非法应改为1-20。"));
       return false;
     }
 
-    const std::regex username_regex("^[a-zA-Z0-9_-]+$");
-
-    bool r = std::regex_match(std::string(info.username), username_regex);
-    if (!r) {
+    if (!is_valid_username(info.username)) {
       res.set_status_and_content(status_type::bad_request,
                                  make_error("用户名只允许字母 (a-z, A-Z), 数字 "
                                             "(0-9), 下划线 (_), 连字符 (-)。"));
@@ -128,16 +312,48 @@ struct check_user_name {
   }
 };
 
-std::pair<bool, std::string> validate_email_format(std::string_view email) {
-  if (email.empty() || email.size() > 254) {
-    return {false, "邮箱格式不合法。"};
+/**
+ * @brief 邮箱格式校验，等价于
+ * [a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,}
+ * 域名中最后一个点之后必须是至少两个字母，且点前面至少有一个字符
+ */
+inline bool is_valid_email(std::string_view email) {
+  auto at = email.find('@');
+  if (at == 0 || at == std::string_view::npos) {
+    return false;
   }
 
-  static const std::regex email_regex(
-      R"([a-zA-Z0-9._%+-]+@[a-zA-Z0-9.-]+\.[a-zA-Z]{2,})");
-  bool r = std::regex_match(std::string{email}, email_regex);
+  auto local = email.substr(0, at);
+  for (char c : local) {
+    if (!is_ascii_alnum(c) && c != '.' && c != '_' && c != '%' && c != '+' &&
+        c != '-') {
+      return false;
+    }
+  }
+
+  auto domain = email.substr(at + 1);
+  for (char c : domain) {
+    if (!is_ascii_alnum(c) && c != '.' && c != '-') {
+      return false;
+    }
+  }
+
+  auto dot = domain.rfind('.');
+  if (dot == 0 || dot == std::string_view::npos ||
+      domain.size() - dot - 1 < 2) {
+    return false;
+  }
+  for (char c : domain.substr(dot + 1)) {
+    if (!is_ascii_alpha(c)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  if (!r) {
+inline std::pair<bool, std::string_view>
+validate_email_format(std::string_view email) {
+  if (email.empty() || email.size() > 254 || !is_valid_email(email)) {
     return {false, "邮箱格式不合法。"};
   }
   return {true, ""};
@@ -145,7 +361,7 @@ std::pair<bool, std::string> validate_email_format(std::string_view email) {
 
 struct check_email {
   bool before(coro_http_request &req, coro_http_response &res) {
-    register_info info = std::any_cast<register_info>(req.get_user_data());
+    register_info info = get_request_data<register_info>(req);
     auto [valid, error_msg] = validate_email_format(info.email);
     if (!valid) {
       res.set_status_and_content(status_type::bad_request,
@@ -157,8 +373,8 @@ struct check_email {
 };
 
 // 验证密码复杂度的独立函数
-std::pair<bool, std::string>
-validate_password_complexity(const std::string &password) {
+inline std::pair<bool, std::string_view>
+validate_password_complexity(std::string_view password) {
   // 检查密码长度
   if (password.size() < 6 || password.size() > 20) {
     return {false, "密码长度不合法，长度6-20位。"};
@@ -170,11 +386,11 @@ validate_password_complexity(const std::string &password) {
 
   // 检查字符类型要求
   for (char c : password) {
-    if (std::isupper(static_cast<unsigned char>(c))) {
+    if (c >= 'A' && c <= 'Z') {
       has_upper = true;
-    } else if (std::islower(static_cast<unsigned char>(c))) {
+    } else if (c >= 'a' && c <= 'z') {
       has_lower = true;
-    } else if (std::isdigit(static_cast<unsigned char>(c))) {
+    } else if (is_ascii_digit(c)) {
       has_digit = true;
     }
   }
@@ -189,7 +405,7 @@ validate_password_complexity(const std::string &password) {
 
 struct check_password {
   bool before(coro_http_request &req, coro_http_response &res) {
-    register_info info = std::any_cast<register_info>(req.get_user_data());
+    register_info info = get_request_data<register_info>(req);
     auto [valid, error_msg] = validate_password_complexity(info.password);
     if (!valid) {
       res.set_status_and_content(status_type::bad_request,
@@ -202,7 +418,7 @@ struct check_password {
 
 struct check_user_exists {
   bool before(coro_http_request &req, coro_http_response &res) {
-    register_info info = std::any_cast<register_info>(req.get_user_data());
+    register_info info = get_request_data<register_info>(req);
 
     auto conn = connection_pool<dbng<mysql>>::instance().get();
     if (conn == nullptr) {
@@ -286,7 +502,7 @@ struct check_login_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -317,7 +533,7 @@ struct check_logout_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -373,10 +589,8 @@ struct check_token {
                                  make_error(error_msg));
       return false;
     }
-    // 将token信息保存到切面中
-    std::string payload;
-    iguana::to_json(info, payload);
-    req.params_["user_token"] = payload;
+    // 将token信息保存到请求上下文中
+    set_auth_context(req, {info->user_id, info->iat, info->exp});
     return true;
   }
 };
@@ -411,7 +625,7 @@ struct check_change_password_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -470,7 +684,7 @@ struct check_upload_file {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 
@@ -505,8 +719,7 @@ struct check_upload_file {
 
 struct check_new_password {
   bool before(coro_http_request &req, coro_http_response &res) {
-    change_password_info info =
-        std::any_cast<change_password_info>(req.get_user_data());
+    change_password_info info = get_request_data<change_password_info>(req);
 
     // 验证新密码复杂度
     auto [valid, error_msg] = validate_password_complexity(info.new_password);
@@ -562,7 +775,7 @@ struct check_forgot_password_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -596,7 +809,7 @@ struct check_reset_password_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -604,8 +817,7 @@ struct check_reset_password_input {
 // 重置密码时的密码验证
 struct check_reset_password {
   bool before(coro_http_request &req, coro_http_response &res) {
-    reset_password_info info =
-        std::any_cast<reset_password_info>(req.get_user_data());
+    reset_password_info info = get_request_data<reset_password_info>(req);
 
     // 验证新密码复杂度
     auto [valid, error_msg] = validate_password_complexity(info.new_password);
@@ -709,7 +921,7 @@ struct check_edit_article {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -740,7 +952,7 @@ struct check_verify_email_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -771,7 +983,7 @@ struct check_resend_verification_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
@@ -813,7 +1025,7 @@ struct check_refresh_token_input {
       return false;
     }
 
-    req.set_user_data(info);
+    set_request_data(req, info);
     return true;
   }
 };
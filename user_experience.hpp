@@ -2,7 +2,9 @@
 
 #include "common.hpp"
 #include "config.hpp"
+#include "db_executor.hpp"
 #include "entity.hpp"
+#include <algorithm>
 #include <cinatra.hpp>
 
 using namespace cinatra;
@@ -20,8 +22,8 @@ public:
    * @return 用户等级
    */
   static UserLevel calculate_level(uint64_t experience) {
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    const auto &level_rules = config.level_rules;
+    auto config = purecpp_config::get_instance().user_cfg();
+    const auto &level_rules = config->level_rules;
 
     // 如果没有配置等级规则，使用默认值
     if (level_rules.empty()) {
@@ -66,8 +68,8 @@ public:
    * @return 升级所需经验值
    */
   static uint64_t get_required_experience(UserLevel current_level) {
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    const auto &level_rules = config.level_rules;
+    auto config = purecpp_config::get_instance().user_cfg();
+    const auto &level_rules = config->level_rules;
 
     // 如果没有配置等级规则，使用默认值
     if (level_rules.empty()) {
@@ -132,8 +134,8 @@ public:
    * @return 经验值下限
    */
   static uint64_t get_level_experience_min(UserLevel current_level) {
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    const auto &level_rules = config.level_rules;
+    auto config = purecpp_config::get_instance().user_cfg();
+    const auto &level_rules = config->level_rules;
 
     // 如果没有配置等级规则，使用默认值
     if (level_rules.empty()) {
@@ -220,8 +222,8 @@ public:
     }
 
     // 从配置获取经验值上限
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    const auto &limits = config.experience_limits;
+    auto config = purecpp_config::get_instance().user_cfg();
+    const auto &limits = config->experience_limits;
 
     // 计算当天的起始时间戳
     uint64_t today_start = get_today_start_timestamp();
@@ -594,22 +596,26 @@ public:
    * @param req HTTP请求
    * @param resp HTTP响应
    */
-  void get_user_level(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  get_user_level(coro_http_request &req, coro_http_response &resp) {
     // 从请求中获取用户ID
     auto user_id_str = req.get_header_value("X-User-ID");
     if (user_id_str.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("用户未登录"));
-      return;
+      co_return;
     }
 
     uint64_t user_id = std::stoull(std::string(user_id_str));
     users_t user_info;
 
-    if (!user_level_t::get_user_level_info(user_id, user_info)) {
+    bool found = co_await db_post([&] {
+      return user_level_t::get_user_level_info(user_id, user_info);
+    });
+    if (!found) {
       resp.set_status_and_content(status_type::internal_server_error,
                                   make_error("获取用户信息失败"));
-      return;
+      co_return;
     }
 
     // 计算等级进度
@@ -636,14 +642,15 @@ public:
    * @param req HTTP请求
    * @param resp HTTP响应
    */
-  void get_experience_transactions(coro_http_request &req,
-                                   coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  get_experience_transactions(coro_http_request &req,
+                              coro_http_response &resp) {
     // 从请求中获取用户ID
     auto user_id_str = req.get_header_value("X-User-ID");
     if (user_id_str.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("用户未登录"));
-      return;
+      co_return;
     }
 
     uint64_t user_id = std::stoull(std::string(user_id_str));
@@ -660,54 +667,67 @@ public:
     if (!page_size_str.empty()) {
       page_size = std::stoi(std::string(page_size_str));
     }
+    page = std::max(page, 1);
+    page_size = std::clamp(page_size, 1, 100);
 
-    // 查询经验值交易记录
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
+    // 解析分页游标，有游标时忽略page
+    auto cursor = decode_cursor(req.get_query_value("cursor"));
+    if (!cursor.has_value()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("无效的分页游标"));
+      co_return;
     }
 
-    // 计算总记录数
-    auto total_count =
-        conn->select(count(col(&user_experience_detail_t::id)))
-            .from<user_experience_detail_t>()
-            .where(col(&user_experience_detail_t::user_id).param())
-            .collect(user_id);
+    // 查询经验值交易记录
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 计算总记录数
+      auto total_count =
+          conn->select(count(col(&user_experience_detail_t::id)))
+              .from<user_experience_detail_t>()
+              .where(col(&user_experience_detail_t::user_id).param())
+              .collect(user_id);
+
+      // 查询分页数据，按(created_at, id)键集分页，走(user_id, created_at,
+      // id)索引
+      int offset = (page - 1) * page_size;
+      auto transactions = conn->query_s<user_experience_detail_t>(
+          "user_id = ?" + keyset_page_sql("created_at", "id", cursor.value(),
+                                          page_size, offset),
+          user_id);
+
+      std::optional<std::string> next_cursor;
+      if (transactions.size() == static_cast<size_t>(page_size)) {
+        auto &last = transactions.back();
+        next_cursor = encode_cursor(last.created_at, last.id);
+      }
 
-    // 查询分页数据
-    int offset = (page - 1) * page_size;
-    auto transactions =
-        conn->select(ormpp::all)
-            .from<user_experience_detail_t>()
-            .where(col(&user_experience_detail_t::user_id).param())
-            .order_by(col(&user_experience_detail_t::created_at).desc())
-            .limit(page_size)
-            .offset(offset)
-            .collect(user_id);
+      // 构建响应数据
+      std::vector<experience_transaction_info> transaction_infos;
+      for (const auto &t : transactions) {
+        transaction_infos.push_back(
+            {.id = t.id,
+             .change_type = static_cast<int>(t.change_type),
+             .experience_change = t.experience_change,
+             .balance_after_experience = t.balance_after_experience,
+             .related_id = t.related_id,
+             .related_type = t.related_type,
+             .description = t.description,
+             .created_at = t.created_at});
+      }
 
-    // 构建响应数据
-    std::vector<experience_transaction_info> transaction_infos;
-    for (const auto &t : transactions) {
-      transaction_infos.push_back(
-          {.id = t.id,
-           .change_type = static_cast<int>(t.change_type),
-           .experience_change = t.experience_change,
-           .balance_after_experience = t.balance_after_experience,
-           .related_id = t.related_id,
-           .related_type = t.related_type,
-           .description = t.description,
-           .created_at = t.created_at});
-    }
-
-    experience_transactions_resp resp_data{.transactions = transaction_infos,
-                                           .total_count =
-                                               static_cast<int>(total_count),
-                                           .current_page = page,
-                                           .page_size = page_size};
+      experience_transactions_resp resp_data{.transactions = transaction_infos,
+                                             .total_count =
+                                                 static_cast<int>(total_count),
+                                             .current_page = page,
+                                             .page_size = page_size};
 
-    resp.set_status_and_content(status_type::ok,
-                                make_data(resp_data, "获取经验值交易记录成功"));
+      resp.set_status_and_content(
+          status_type::ok, make_data(resp_data, "获取经验值交易记录成功",
+                                     0, std::move(next_cursor)));
+    });
+    if (!ok) {
+      set_server_internel_error(resp);
+    }
   }
 
   /**
@@ -715,13 +735,14 @@ public:
    * @param req HTTP请求
    * @param resp HTTP响应
    */
-  void purchase_privilege(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  purchase_privilege(coro_http_request &req, coro_http_response &resp) {
     // 从请求中获取用户ID
     auto user_id_str = req.get_header_value("X-User-ID");
     if (user_id_str.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("用户未登录"));
-      return;
+      co_return;
     }
 
     uint64_t user_id = std::stoull(std::string(user_id_str));
@@ -737,15 +758,18 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("请求参数无效"));
-      return;
+      co_return;
     }
 
     // 购买特权
-    if (!user_level_t::purchase_privilege(user_id, info.privilege_id)) {
+    bool purchased = co_await db_post([&] {
+      return user_level_t::purchase_privilege(user_id, info.privilege_id);
+    });
+    if (!purchased) {
       resp.set_status_and_content(
           status_type::bad_request,
           make_error("购买特权失败，可能是积分不足或特权不存在"));
-      return;
+      co_return;
     }
 
     resp.set_status_and_content(status_type::ok, make_success("购买特权成功"));
@@ -756,13 +780,14 @@ public:
    * @param req HTTP请求
    * @param resp HTTP响应
    */
-  void user_gifts(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  user_gifts(coro_http_request &req, coro_http_response &resp) {
     // 从请求中获取用户ID
     auto user_id_str = req.get_header_value("X-User-ID");
     if (user_id_str.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("用户未登录"));
-      return;
+      co_return;
     }
 
     uint64_t sender_id = std::stoull(std::string(user_id_str));
@@ -782,17 +807,20 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("请求参数无效"));
-      return;
+      co_return;
     }
 
     // 打赏用户
-    if (!user_level_t::gift_user(sender_id, info.receiver_id,
-                                 info.points_amount, info.article_id,
-                                 info.comment_id, info.message)) {
+    bool gifted = co_await db_post([&] {
+      return user_level_t::gift_user(sender_id, info.receiver_id,
+                                     info.points_amount, info.article_id,
+                                     info.comment_id, info.message);
+    });
+    if (!gifted) {
       resp.set_status_and_content(
           status_type::bad_request,
           make_error("打赏失败，可能是积分不足或接收者不存在"));
-      return;
+      co_return;
     }
 
     resp.set_status_and_content(status_type::ok, make_success("打赏成功"));
@@ -803,22 +831,21 @@ public:
    * @param req HTTP请求
    * @param resp HTTP响应
    */
-  void get_available_privileges(coro_http_request &req,
-                                coro_http_response &resp) {
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
+  async_simple::coro::Lazy<void>
+  get_available_privileges(coro_http_request &req, coro_http_response &resp) {
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 查询可用特权
+      auto privileges = conn->select(ormpp::all)
+                            .from<privileges_t>()
+                            .where(col(&privileges_t::is_active).param())
+                            .collect(true);
+
+      resp.set_status_and_content(status_type::ok,
+                                  make_data(privileges, "获取可用特权列表成功"));
+    });
+    if (!ok) {
       set_server_internel_error(resp);
-      return;
     }
-
-    // 查询可用特权
-    auto privileges = conn->select(ormpp::all)
-                          .from<privileges_t>()
-                          .where(col(&privileges_t::is_active).param())
-                          .collect(true);
-
-    resp.set_status_and_content(status_type::ok,
-                                make_data(privileges, "获取可用特权列表成功"));
   }
 };
 } // namespace purecpp
\ No newline at end of file
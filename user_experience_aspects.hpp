@@ -2,6 +2,7 @@
 
 #include "common.hpp"
 #include "entity.hpp"
+#include "experience_reward_queue.hpp"
 #include "user_dto.hpp"
 #include "user_experience.hpp"
 #include <cinatra.hpp>
@@ -16,6 +17,8 @@ namespace purecpp {
  * @brief 经验值奖励切面类
  * 用于在用户执行特定操作后自动给予经验值奖励
  * 统一管理所有经验值奖励，包括原有的积分奖励和经验值奖励
+ * 奖励只放入experience_reward_queue，由后台线程批量写入数据库，
+ * 检查每日上限和是否已领取登录奖励也在后台线程中进行
  */
 struct experience_reward_aspect {
   /**
@@ -70,7 +73,7 @@ private:
                               coro_http_response &resp) {
     // 从响应中获取用户信息
     auto resp_body = resp.content();
-    if (resp_body.empty()) {
+    if (resp.status() != status_type::ok || resp_body.empty()) {
       return;
     }
 
@@ -90,13 +93,14 @@ private:
     }
 
     // 从配置获取注册奖励经验值
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    int32_t reward = config.experience_rewards.register_reward;
+    auto config = purecpp_config::get_instance().user_cfg();
+    int32_t reward = config->experience_rewards.register_reward;
 
     // 给予注册经验值奖励（原积分奖励+经验值奖励合并）
-    user_level_t::add_experience(register_result.data.user_id, reward,
-                                 ExperienceChangeType::REGISTER, std::nullopt,
-                                 std::nullopt, "注册奖励");
+    experience_reward_queue::instance().emit(register_result.data.user_id,
+                                             reward,
+                                             ExperienceChangeType::REGISTER,
+                                             "注册奖励");
   }
 
   /**
@@ -107,7 +111,7 @@ private:
   void handle_login_reward(coro_http_request &req, coro_http_response &resp) {
     // 从响应中获取用户信息
     auto resp_body = resp.content();
-    if (resp_body.empty()) {
+    if (resp.status() != status_type::ok || resp_body.empty()) {
       return;
     }
 
@@ -126,42 +130,16 @@ private:
       return;
     }
 
+    // 今天是否已经获得过登录奖励由后台线程检查
     uint64_t user_id = login_result.data.user_id;
 
-    // 检查今天是否已经获得过登录奖励
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      return;
-    }
-
-    // 获取今天的起始时间戳（毫秒）
-    uint64_t now = get_timestamp_milliseconds();
-    uint64_t one_day_ms = 24 * 60 * 60 * 1000;
-    uint64_t today_start = now - (now % one_day_ms);
-
-    // 直接使用SQL查询今天是否已经有过登录奖励记录
-    auto experience_details =
-        conn->select(ormpp::all)
-            .from<user_experience_detail_t>()
-            .where(ormpp::col(&user_experience_detail_t::user_id).param() &&
-                   ormpp::col(&user_experience_detail_t::change_type).param() &&
-                   ormpp::col(&user_experience_detail_t::created_at) >
-                       today_start)
-            .collect(user_id, ExperienceChangeType::DAILY_LOGIN);
-
-    if (experience_details.size() > 0) {
-      // 今天已经获得过登录奖励，不再重复奖励
-      return;
-    }
-
     // 从配置获取每日登录奖励经验值
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    int32_t reward = config.experience_rewards.daily_login_reward;
+    auto config = purecpp_config::get_instance().user_cfg();
+    int32_t reward = config->experience_rewards.daily_login_reward;
 
     // 给予每日登录经验值奖励
-    user_level_t::add_experience(user_id, reward,
-                                 ExperienceChangeType::DAILY_LOGIN,
-                                 std::nullopt, std::nullopt, "每日登录奖励");
+    experience_reward_queue::instance().emit(
+        user_id, reward, ExperienceChangeType::DAILY_LOGIN, "每日登录奖励");
   }
 
   /**
@@ -182,13 +160,12 @@ private:
     }
 
     // 从配置获取发布文章奖励经验值
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    int32_t reward = config.experience_rewards.publish_article_reward;
+    auto config = purecpp_config::get_instance().user_cfg();
+    int32_t reward = config->experience_rewards.publish_article_reward;
 
     // 给予发布文章经验值奖励（原积分奖励+经验值奖励合并）
-    user_level_t::add_experience(user_id, reward,
-                                 ExperienceChangeType::PUBLISH_ARTICLE,
-                                 std::nullopt, std::nullopt, "发布文章奖励");
+    experience_reward_queue::instance().emit(
+        user_id, reward, ExperienceChangeType::PUBLISH_ARTICLE, "发布文章奖励");
   }
 
   /**
@@ -209,13 +186,12 @@ private:
     }
 
     // 从配置获取发布评论奖励经验值
-    auto &config = purecpp_config::get_instance().user_cfg_;
-    int32_t reward = config.experience_rewards.publish_comment_reward;
+    auto config = purecpp_config::get_instance().user_cfg();
+    int32_t reward = config->experience_rewards.publish_comment_reward;
 
     // 给予发布评论经验值奖励（原积分奖励+经验值奖励合并）
-    user_level_t::add_experience(user_id, reward,
-                                 ExperienceChangeType::PUBLISH_COMMENT,
-                                 std::nullopt, std::nullopt, "发布评论奖励");
+    experience_reward_queue::instance().emit(
+        user_id, reward, ExperienceChangeType::PUBLISH_COMMENT, "发布评论奖励");
   }
 };
 
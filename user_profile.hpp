@@ -1,6 +1,10 @@
 #pragma once
 
+#include "avatar_thumbnail.hpp"
+#include "db_executor.hpp"
 #include "entity.hpp"
+#include "file_sink.hpp"
+#include "upload_stream.hpp"
 #include "user_aspects.hpp"
 
 #include <cinatra.hpp>
@@ -15,7 +19,8 @@ public:
   /**
    * @brief 获取用户的个人信息，支持通过user_id或username查询
    */
-  void get_user_profile(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  get_user_profile(coro_http_request &req, coro_http_response &resp) {
     // 从请求中获取用户ID或用户名
     auto body = req.get_body();
 
@@ -31,76 +36,76 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error(ec.message()));
-      return;
+      co_return;
     }
 
     // 用户id和username不能同时为空
     if (request.user_id == 0 && request.username.empty()) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("用户ID或用户名不能为空"));
-      return;
+      co_return;
     }
 
     // 查询数据库
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 查询用户信息
+      std::vector<users_t> users;
+      if (request.user_id != 0) {
+        // 通过user_id查询
+        users = conn->select(ormpp::all)
+                    .from<users_t>()
+                    .where(col(&users_t::id).param())
+                    .collect<users_t>(request.user_id);
+      } else {
+        // 通过username查询
+        users = conn->select(ormpp::all)
+                    .from<users_t>()
+                    .where(col(&users_t::user_name).param())
+                    .collect<users_t>(request.username);
+      }
 
-    // 查询用户信息
-    std::vector<users_t> users;
-    if (request.user_id != 0) {
-      // 通过user_id查询
-      users = conn->select(ormpp::all)
-                  .from<users_t>()
-                  .where(col(&users_t::id).param())
-                  .collect<users_t>(request.user_id);
-    } else {
-      // 通过username查询
-      users = conn->select(ormpp::all)
-                  .from<users_t>()
-                  .where(col(&users_t::user_name).param())
-                  .collect<users_t>(request.username);
-    }
+      if (users.empty()) {
+        resp.set_status_and_content(status_type::bad_request,
+                                    make_error("用户不存在"));
+        return;
+      }
 
-    if (users.empty()) {
-      resp.set_status_and_content(status_type::bad_request,
-                                  make_error("用户不存在"));
-      return;
-    }
+      auto &user = users[0];
 
-    auto &user = users[0];
-
-    // 构建响应
-    get_profile_response profile;
-    // 使用安全的字符串转换，避免未终止字符串问题
-    profile.username = std::string(
-        user.user_name.data(),
-        std::find(user.user_name.begin(), user.user_name.end(), '\0'));
-    profile.email =
-        std::string(user.email.data(),
-                    std::find(user.email.begin(), user.email.end(), '\0'));
-    profile.location = user.location;
-    profile.bio = user.bio;
-    profile.avatar = user.avatar;
-    profile.skills = user.skills;
-    profile.created_at = user.created_at;
-    profile.last_active_at = user.last_active_at;
-    profile.title = user.title;
-    profile.role = user.role;
-    profile.experience = user.experience;
-    profile.level = user.level;
-    profile.status = user.status;
-
-    std::string json = make_data(profile, "获取用户信息成功");
-    resp.set_status_and_content(status_type::ok, std::move(json));
+      // 构建响应
+      get_profile_response profile;
+      // 使用安全的字符串转换，避免未终止字符串问题
+      profile.username = std::string(
+          user.user_name.data(),
+          std::find(user.user_name.begin(), user.user_name.end(), '\0'));
+      profile.email =
+          std::string(user.email.data(),
+                      std::find(user.email.begin(), user.email.end(), '\0'));
+      profile.location = user.location;
+      profile.bio = user.bio;
+      profile.avatar = user.avatar;
+      profile.skills = user.skills;
+      profile.created_at = user.created_at;
+      profile.last_active_at = user.last_active_at;
+      profile.title = user.title;
+      profile.role = user.role;
+      profile.experience = user.experience;
+      profile.level = user.level;
+      profile.status = user.status;
+
+      std::string json = make_data(profile, "获取用户信息成功");
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    });
+    if (!ok) {
+      set_server_internel_error(resp);
+    }
   }
 
   /**
    * @brief 更新当前用户的个人信息
    */
-  void update_user_profile(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  update_user_profile(coro_http_request &req, coro_http_response &resp) {
     // 从请求体中获取更新信息
     auto body = req.get_body();
     user_profile_request update_info;
@@ -109,84 +114,85 @@ public:
     if (ec) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error(ec.message()));
-      return;
+      co_return;
     }
 
     // 用户id不能不能为空
     if (update_info.user_id == 0) {
       resp.set_status_and_content(status_type::bad_request,
                                   make_error("用户ID不能为空"));
-      return;
+      co_return;
     }
 
     // 查询数据库
-    auto conn = connection_pool<dbng<mysql>>::instance().get();
-    if (conn == nullptr) {
-      set_server_internel_error(resp);
-      return;
-    }
-
-    // 获取现有用户信息
-    auto users = conn->select(ormpp::all)
-                     .from<users_t>()
-                     .where(col(&users_t::id).param())
-                     .collect(update_info.user_id);
+    bool ok = co_await db_exec([&](db_conn &conn) {
+      // 获取现有用户信息
+      auto users = conn->select(ormpp::all)
+                       .from<users_t>()
+                       .where(col(&users_t::id).param())
+                       .collect(update_info.user_id);
 
-    if (users.empty()) {
-      resp.set_status_and_content(status_type::bad_request,
-                                  make_error("用户不存在"));
-      return;
-    }
+      if (users.empty()) {
+        resp.set_status_and_content(status_type::bad_request,
+                                    make_error("用户不存在"));
+        return;
+      }
 
-    users_t user = users[0];
+      users_t user = users[0];
 
-    // 更新数据库中的指定字段
-    bool update_success = true;
-    users_t update_user;
-    std::string condition = "id=" + std::to_string(user.id);
+      // 更新数据库中的指定字段
+      bool update_success = true;
+      users_t update_user;
+      std::string condition = "id=" + std::to_string(user.id);
+
+      if (update_info.location.has_value()) {
+        update_user.location = update_info.location;
+        if (conn->update_some<&users_t::location>(update_user, condition) !=
+            1) {
+          update_success = false;
+        }
+      }
 
-    if (update_info.location.has_value()) {
-      update_user.location = update_info.location;
-      if (conn->update_some<&users_t::location>(update_user, condition) != 1) {
-        update_success = false;
+      if (update_info.bio.has_value() && update_success) {
+        update_user.bio = update_info.bio;
+        if (conn->update_some<&users_t::bio>(update_user, condition) != 1) {
+          update_success = false;
+        }
       }
-    }
 
-    if (update_info.bio.has_value() && update_success) {
-      update_user.bio = update_info.bio;
-      if (conn->update_some<&users_t::bio>(update_user, condition) != 1) {
-        update_success = false;
+      if (update_info.avatar.has_value() && update_success) {
+        update_user.avatar = update_info.avatar;
+        if (conn->update_some<&users_t::avatar>(update_user, condition) != 1) {
+          update_success = false;
+        }
       }
-    }
 
-    if (update_info.avatar.has_value() && update_success) {
-      update_user.avatar = update_info.avatar;
-      if (conn->update_some<&users_t::avatar>(update_user, condition) != 1) {
-        update_success = false;
+      if (update_info.skills.has_value() && update_success) {
+        update_user.skills = update_info.skills;
+        if (conn->update_some<&users_t::skills>(update_user, condition) != 1) {
+          update_success = false;
+        }
       }
-    }
 
-    if (update_info.skills.has_value() && update_success) {
-      update_user.skills = update_info.skills;
-      if (conn->update_some<&users_t::skills>(update_user, condition) != 1) {
-        update_success = false;
+      if (!update_success) {
+        resp.set_status_and_content(status_type::internal_server_error,
+                                    make_error("更新用户信息失败"));
+        return;
       }
-    }
 
-    if (!update_success) {
-      resp.set_status_and_content(status_type::internal_server_error,
-                                  make_error("更新用户信息失败"));
-      return;
+      resp.set_status_and_content(status_type::ok,
+                                  make_success("更新用户信息成功"));
+    });
+    if (!ok) {
+      set_server_internel_error(resp);
     }
-
-    resp.set_status_and_content(status_type::ok,
-                                make_success("更新用户信息成功"));
   }
 
   /**
    * @brief 处理用户头像上传
    */
-  void upload_avatar(coro_http_request &req, coro_http_response &resp) {
+  async_simple::coro::Lazy<void>
+  upload_avatar(coro_http_request &req, coro_http_response &resp) {
     try {
       // 获取请求体
       auto body = req.get_body();
@@ -197,20 +203,20 @@ public:
       if (ec) {
         resp.set_status_and_content(status_type::bad_request,
                                     make_error(ec.message()));
-        return;
+        co_return;
       }
 
       // 验证请求参数
       if (upload_req.user_id == 0) {
         resp.set_status_and_content(status_type::bad_request,
                                     make_error("用户ID不能为空"));
-        return;
+        co_return;
       }
 
       if (upload_req.avatar_data.empty() || upload_req.filename.empty()) {
         resp.set_status_and_content(status_type::bad_request,
                                     make_error("没有找到上传的头像文件"));
-        return;
+        co_return;
       }
 
       // 检查文件类型
@@ -220,7 +226,7 @@ public:
         resp.set_status_and_content(
             status_type::bad_request,
             make_error("只支持JPG、PNG、GIF格式的图片"));
-        return;
+        co_return;
       }
 
       // 解码base64图片数据
@@ -228,23 +234,18 @@ public:
       if (!opt_avatar_data.has_value()) {
         resp.set_status_and_content(status_type::bad_request,
                                     make_error("base64图片数据解码失败"));
-        return;
+        co_return;
       }
 
       std::string &avatar_data = opt_avatar_data.value();
       // 检查文件大小（2MB限制）
-      const size_t MAX_SIZE = 512 * 1024;
-      if (avatar_data.length() > MAX_SIZE) {
+      if (avatar_data.length() > max_avatar_size) {
         resp.set_status_and_content(status_type::bad_request,
                                     make_error("图片大小不能超过512KB"));
-        return;
+        co_return;
       }
 
-      // 确保uploads目录存在
       std::filesystem::path upload_dir = "html/uploads/avatars";
-      if (!std::filesystem::exists(upload_dir)) {
-        std::filesystem::create_directories(upload_dir);
-      }
 
       // 生成唯一文件名
       std::string unique_filename =
@@ -252,32 +253,92 @@ public:
           std::to_string(get_timestamp_milliseconds()) + "." + ext;
       std::filesystem::path file_path = upload_dir / unique_filename;
 
-      // 保存文件
-      std::ofstream out_file(file_path, std::ios::binary);
-      if (!out_file) {
-        resp.set_status_and_content(status_type::internal_server_error,
-                                    make_error("保存文件失败"));
-        return;
+      // 在文件线程池上保存文件，目录不存在时创建
+      auto status =
+          co_await file_sink::instance().write_file(file_path, avatar_data);
+      if (status != sink_status::ok) {
+        set_file_sink_error(resp, status);
+        co_return;
       }
-      out_file.write(reinterpret_cast<const char *>(avatar_data.data()),
-                     avatar_data.size());
-      out_file.close();
 
       // 生成文件URL
       std::string file_url = "/uploads/avatars/" + unique_filename;
 
       // 更新用户的avatar字段
-      auto conn = connection_pool<dbng<mysql>>::instance().get();
-      if (conn == nullptr) {
-        set_server_internel_error(resp);
-        return;
+      if (!co_await update_avatar(upload_req.user_id, file_url, resp)) {
+        co_return;
       }
+      avatar_thumbnailer::instance().submit(file_path.string());
+
+      // 构建响应
+      struct upload_response {
+        std::string url;
+        std::string filename;
+      };
+
+      upload_response data;
+      data.url = file_url;
+      data.filename = unique_filename;
 
+      std::string json = make_data(data, "头像上传成功");
+      resp.set_status_and_content(status_type::ok, std::move(json));
+    } catch (const std::exception &e) {
+      CINATRA_LOG_ERROR << "头像上传失败: " << e.what();
+      resp.set_status_and_content(
+          status_type::internal_server_error,
+          make_error(std::string("头像上传失败: ") + e.what()));
+    }
+  }
+
+  /**
+   * @brief multipart上传头像，文件名通过?filename=传入，用户ID取自令牌
+   */
+  async_simple::coro::Lazy<void>
+  upload_avatar_raw(coro_http_request &req, coro_http_response &resp) {
+    uint64_t user_id = get_user_id_from_token(req);
+    std::string ext = get_raw_upload_extension(req);
+    if (ext.empty()) {
+      resp.set_status_and_content(status_type::bad_request,
+                                  make_error("只支持JPG、PNG、GIF格式的图片"));
+      co_return;
+    }
+
+    std::string unique_filename = "avatar_" + std::to_string(user_id) + "_" +
+                                  std::to_string(get_timestamp_milliseconds()) +
+                                  ext;
+    if (!co_await receive_upload(req, resp, "html/uploads/avatars",
+                                 unique_filename, max_avatar_size,
+                                 "图片大小不能超过512KB")) {
+      co_return;
+    }
+
+    std::string file_url = "/uploads/avatars/" + unique_filename;
+    if (!co_await update_avatar(user_id, file_url, resp)) {
+      co_return;
+    }
+    avatar_thumbnailer::instance().submit("html" + file_url);
+
+    upload_response data{file_url, unique_filename};
+    std::string json = make_data(data, "头像上传成功");
+    resp.set_status_and_content(status_type::ok, std::move(json));
+  }
+
+private:
+  static constexpr size_t max_avatar_size = 512 * 1024;
+
+  /**
+   * @brief 更新用户的头像地址，失败时设置错误响应
+   */
+  async_simple::coro::Lazy<bool> update_avatar(uint64_t user_id,
+                                               const std::string &file_url,
+                                               coro_http_response &resp) {
+    bool updated = false;
+    bool ok = co_await db_exec([&](db_conn &conn) {
       // 获取现有用户信息
       auto users = conn->select(ormpp::all)
                        .from<users_t>()
                        .where(col(&users_t::id).param())
-                       .collect(upload_req.user_id);
+                       .collect(user_id);
 
       if (users.empty()) {
         resp.set_status_and_content(status_type::bad_request,
@@ -290,35 +351,20 @@ public:
 
       // 更新数据库
       if (conn->update_some<&users_t::avatar>(
-              update_user, "id=" + std::to_string(upload_req.user_id)) != 1) {
+              update_user, "id=" + std::to_string(user_id)) != 1) {
         resp.set_status_and_content(status_type::internal_server_error,
                                     make_error("更新用户头像失败"));
         return;
       }
-
-      // 构建响应
-      struct upload_response {
-        std::string url;
-        std::string filename;
-      };
-
-      upload_response data;
-      data.url = file_url;
-      data.filename = unique_filename;
-
-      std::string json = make_data(data, "头像上传成功");
-      resp.set_status_and_content(status_type::ok, std::move(json));
-      return;
-    } catch (const std::exception &e) {
-      CINATRA_LOG_ERROR << "头像上传失败: " << e.what();
-      resp.set_status_and_content(
-          status_type::internal_server_error,
-          make_error(std::string("头像上传失败: ") + e.what()));
-      return;
+      updated = true;
+    });
+    if (!ok) {
+      set_server_internel_error(resp);
+      co_return false;
     }
+    co_return updated;
   }
 
-private:
   /**
    * @brief 检查字符是否为Base64字符
    */
@@ -7,7 +7,6 @@
 #include "user_experience.hpp"
 #include <cinatra/smtp_client.hpp>
 #include <openssl/sha.h>
-#include <regex>
 
 using namespace cinatra;
 
@@ -43,8 +42,7 @@ public:
   // 处理用户注册请求（改为异步方法）
   async_simple::coro::Lazy<void> handle_register(coro_http_request &req,
                                                  coro_http_response &resp) {
-    register_info info = std::any_cast<register_info>(req.get_user_data());
-    const auto &cfg = purecpp_config::get_instance().user_cfg_;
+    register_info info = get_request_data<register_info>(req);
 
     // save to temporary database first
     users_tmp_t user_tmp{.id = generate_user_id(),
@@ -121,8 +119,7 @@ public:
   // 处理邮箱验证请求
   static void handle_verify_email(coro_http_request &req,
                                   coro_http_response &resp) {
-    verify_email_info info =
-        std::any_cast<verify_email_info>(req.get_user_data());
+    verify_email_info info = get_request_data<verify_email_info>(req);
 
     auto conn = connection_pool<dbng<mysql>>::instance().get();
     if (conn == nullptr) {
@@ -165,7 +162,7 @@ public:
     }
 
     auto user_tmp = users_tmp[0];
-    const auto &cfg = purecpp_config::get_instance().user_cfg_;
+    auto cfg = purecpp_config::get_instance().user_cfg();
 
     // 开启事务(先插入正式表，再删除临时表)
     conn->begin();
@@ -178,7 +175,7 @@ public:
                  .last_active_at = get_timestamp_milliseconds(),
                  .experience = 0,             // 初始经验值
                  .level = UserLevel::LEVEL_1, // 初始等级
-                 .avatar = cfg.default_avatar_url.data()};
+                 .avatar = cfg->default_avatar_url.data()};
 
     // 复制用户名和邮箱
     std::copy_n(std::begin(user_tmp.user_name), user_tmp.user_name.size(),
@@ -217,7 +214,7 @@ public:
   static async_simple::coro::Lazy<void>
   handle_resend_verify_email(coro_http_request &req, coro_http_response &resp) {
     resend_verify_email_info info =
-        std::any_cast<resend_verify_email_info>(req.get_user_data());
+        get_request_data<resend_verify_email_info>(req);
 
     // 查询数据库中是否已存在该邮箱的用户，先查临时表再查正式表
     auto conn = connection_pool<dbng<mysql>>::instance().get();
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "article_cache.hpp"
+#include "entity.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cinatra.hpp>
+
+namespace purecpp {
+
+/**
+ * @brief 文章浏览量计数器
+ * 每次浏览只在内存中累加，由后台线程每隔一段时间把增量合并成一条多行
+ * UPDATE写回数据库，避免热门文章的浏览量更新成为行锁热点。
+ * 写回成功后把增量加到article_cache中缓存的浏览量上，缓存不会因此失效。
+ * 停止时会把剩余的增量全部写回。
+ */
+class view_counter {
+public:
+  view_counter(const view_counter &) = delete;
+  view_counter &operator=(const view_counter &) = delete;
+
+  static view_counter &instance() {
+    static view_counter instance;
+    return instance;
+  }
+
+  /**
+   * @brief 启动后台刷新线程
+   * @param flush_interval_seconds 刷新间隔（秒）
+   */
+  void start(int flush_interval_seconds) {
+    std::lock_guard lock(thd_mutex_);
+    if (thd_.joinable()) {
+      return;
+    }
+
+    stop_ = false;
+    interval_ = std::chrono::seconds(std::max(flush_interval_seconds, 1));
+    thd_ = std::thread([this] {
+      std::unique_lock lock(thd_mutex_);
+      while (!stop_) {
+        cv_.wait_for(lock, interval_, [this] { return stop_; });
+        lock.unlock();
+        flush();
+        lock.lock();
+      }
+    });
+  }
+
+  /**
+   * @brief 停止后台线程，并把剩余的增量写回数据库
+   */
+  void stop() {
+    {
+      std::lock_guard lock(thd_mutex_);
+      if (!thd_.joinable()) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thd_.join();
+  }
+
+  /**
+   * @brief 浏览量加1
+   * @return 该文章尚未写回数据库的浏览量增量
+   */
+  uint64_t increment(std::string_view slug) {
+    auto &shard = get_shard(slug);
+    {
+      std::shared_lock lock(shard.mutex);
+      auto it = shard.counters.find(slug);
+      if (it != shard.counters.end()) {
+        return it->second.fetch_add(1, std::memory_order_relaxed) + 1;
+      }
+    }
+
+    std::unique_lock lock(shard.mutex);
+    auto [it, _] = shard.counters.try_emplace(std::string(slug), 0);
+    return it->second.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  /**
+   * @brief 获取尚未写回数据库的浏览量增量
+   */
+  uint64_t pending(std::string_view slug) {
+    auto &shard = get_shard(slug);
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.counters.find(slug);
+    if (it == shard.counters.end()) {
+      return 0;
+    }
+    return it->second.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 阻止浏览量写回，直到返回的锁释放
+   * 从数据库读取文章详情并写入article_cache时持有，避免读到写回前的
+   * 浏览量，而写回时缓存中还没有该文章，之后写入的缓存少算这次写回的增量
+   */
+  std::shared_lock<std::shared_mutex> hold_flush() {
+    return std::shared_lock(flush_mutex_);
+  }
+
+  /**
+   * @brief 把所有增量写回数据库
+   * 写入成功后再从计数器中扣除，失败的增量留到下一次刷新
+   */
+  void flush() {
+    std::vector<std::pair<std::string, uint64_t>> deltas;
+    for (auto &shard : shards_) {
+      std::shared_lock lock(shard.mutex);
+      for (auto &[slug, count] : shard.counters) {
+        uint64_t n = count.load(std::memory_order_relaxed);
+        if (n > 0) {
+          deltas.emplace_back(slug, n);
+        }
+      }
+    }
+
+    if (deltas.empty()) {
+      return;
+    }
+
+    auto conn = connection_pool<dbng<mysql>>::instance().get();
+    if (conn == nullptr) {
+      CINATRA_LOG_WARNING << "flush views count failed, no db connection";
+      return;
+    }
+
+    for (size_t i = 0; i < deltas.size(); i += batch_size) {
+      auto first = deltas.begin() + i;
+      auto last = deltas.begin() + std::min(i + batch_size, deltas.size());
+      std::unique_lock lock(flush_mutex_);
+      if (!conn->execute(build_update_sql(first, last))) {
+        CINATRA_LOG_ERROR << "flush views count failed";
+        continue;
+      }
+
+      for (auto it = first; it != last; ++it) {
+        // 缓存中的浏览量和数据库保持一致，增量转入缓存后从计数器扣除
+        article_cache::instance().add_views(it->first, it->second);
+        subtract(it->first, it->second);
+      }
+    }
+  }
+
+private:
+  view_counter() = default;
+  ~view_counter() { stop(); }
+
+  static constexpr size_t shard_num = 16;
+  static constexpr size_t batch_size = 500;
+
+  struct string_hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view sv) const {
+      return std::hash<std::string_view>{}(sv);
+    }
+  };
+
+  struct shard_t {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, std::atomic<uint64_t>, string_hash,
+                       std::equal_to<>>
+        counters;
+  };
+
+  shard_t &get_shard(std::string_view slug) {
+    return shards_[std::hash<std::string_view>{}(slug) % shard_num];
+  }
+
+  void subtract(std::string_view slug, uint64_t n) {
+    auto &shard = get_shard(slug);
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.counters.find(slug);
+    if (it == shard.counters.end()) {
+      return;
+    }
+    // 持有写锁时没有并发的累加，可以安全地删除归零的计数
+    if (it->second.fetch_sub(n, std::memory_order_relaxed) == n) {
+      shard.counters.erase(it);
+    }
+  }
+
+  static bool is_valid_slug(std::string_view slug) {
+    return !slug.empty() && std::all_of(slug.begin(), slug.end(), [](char c) {
+      return std::isalnum(static_cast<unsigned char>(c));
+    });
+  }
+
+  /**
+   * @brief 生成批量更新语句
+   * UPDATE articles SET views_count = views_count + CASE slug
+   * WHEN 'a' THEN 3 WHEN 'b' THEN 1 END WHERE slug IN ('a','b')
+   */
+  template <typename It>
+  static std::string build_update_sql(It first, It last) {
+    std::string cases;
+    std::string slugs;
+    for (auto it = first; it != last; ++it) {
+      // slug由字母和数字组成，其它字符一律跳过，防止拼接sql时注入
+      if (!is_valid_slug(it->first)) {
+        continue;
+      }
+      cases.append(" WHEN '")
+          .append(it->first)
+          .append("' THEN ")
+          .append(std::to_string(it->second));
+      if (!slugs.empty()) {
+        slugs.append(",");
+      }
+      slugs.append("'").append(it->first).append("'");
+    }
+
+    if (slugs.empty()) {
+      // 没有合法的slug，生成一条不影响任何行的语句
+      return "UPDATE `articles` SET views_count = views_count WHERE 1 = 0";
+    }
+
+    std::string sql =
+        "UPDATE `articles` SET views_count = views_count + CASE slug";
+    sql.append(cases).append(" END WHERE slug IN (").append(slugs).append(")");
+    return sql;
+  }
+
+  std::array<shard_t, shard_num> shards_;
+  std::shared_mutex flush_mutex_;
+
+  std::thread thd_;
+  std::mutex thd_mutex_;
+  std::condition_variable cv_;
+  std::chrono::seconds interval_{10};
+  bool stop_ = false;
+};
+
+} // namespace purecpp